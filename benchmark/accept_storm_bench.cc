@@ -0,0 +1,138 @@
+/*
+连接风暴下批量accept的效果
+用法: ./accept_storm_bench [accept批量] [每轮连接数] [轮数] [subloop数]
+每一轮同时发起N个非阻塞connect, 等待所有连接都收到服务器在建立时发送的1个字节, 然后全部用RST关闭
+统计连接建立速率, 以及BaseLoop向subloop投递的回调数(handoffs)和实际写eventfd的次数(wakeups)
+服务器的日志较多, 运行时建议把stdout重定向到/dev/null, 结果输出到stderr
+*/
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/Logger.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <poll.h>
+#include <signal.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+static const uint16_t kPort = 9534;
+
+// 返回成功收到服务器数据的连接数
+static int Storm(int conns)
+{
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(kPort);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+
+    std::vector<pollfd> fds(conns);
+    for (int i = 0; i < conns; i++)
+    {
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        connect(fd, (sockaddr*)&addr, sizeof(addr));
+        fds[i].fd = fd;
+        fds[i].events = POLLIN;
+    }
+
+    int done = 0;
+    int remaining = conns;
+    while (remaining > 0)
+    {
+        int n = poll(fds.data(), fds.size(), 5000);
+        if (n <= 0)
+        {
+            break;
+        }
+        for (pollfd& p : fds)
+        {
+            if (p.fd >= 0 && p.revents != 0)
+            {
+                char c;
+                if (read(p.fd, &c, 1) == 1)
+                {
+                    ++done;
+                }
+                linger lg;
+                lg.l_onoff = 1;
+                lg.l_linger = 0;
+                setsockopt(p.fd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+                close(p.fd);
+                p.fd = -1;
+                --remaining;
+            }
+        }
+    }
+    for (pollfd& p : fds)
+    {
+        if (p.fd >= 0)
+        {
+            close(p.fd);
+        }
+    }
+    return done;
+}
+
+int main(int argc, char* argv[])
+{
+    int batch = argc > 1 ? atoi(argv[1]) : 64;
+    int conns = argc > 2 ? atoi(argv[2]) : 1000;
+    int rounds = argc > 3 ? atoi(argv[3]) : 20;
+    int threads = argc > 4 ? atoi(argv[4]) : 4;
+
+    signal(SIGPIPE, SIG_IGN);
+
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort), "AcceptStormBench");
+    server.SetThreadNum(threads);
+    server.SetAcceptBatch(batch);
+    std::mutex mutex;
+    std::vector<EventLoop*> io_loops;
+    server.SetThreadInitCallback([&](EventLoop* io_loop) {
+        std::lock_guard<std::mutex> lock(mutex);
+        io_loops.push_back(io_loop);
+    });
+    server.SetConnectionCallback([](const TcpConnectionPtr& conn) {
+        if (conn->Connected())
+        {
+            conn->Send("x");
+        }
+    });
+    server.SetMessageCallback([](const TcpConnectionPtr&, Buffer* buf, TimeStamp) { buf->RetrieveAll(); });
+    server.Start();
+
+    long done = 0;
+    double seconds = 0;
+    std::thread driver([&]() {
+        usleep(100 * 1000);
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < rounds; i++)
+        {
+            done += Storm(conns);
+        }
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        loop.Quit();
+    });
+
+    loop.Loop();
+    driver.join();
+
+    // 每个连接关闭时BaseLoop还会向subloop投递一次ConnectDestoryed, 也计入handoffs
+    uint64_t wakeups = 0;
+    uint64_t handoffs = 0;
+    for (EventLoop* io_loop : io_loops)
+    {
+        wakeups += io_loop->WakeupWrites();
+        handoffs += io_loop->WakeupWrites() + io_loop->WakeupsCoalesced();
+    }
+    fprintf(stderr, "accept_batch=%d conns/round=%d rounds=%d established=%ld rate=%.0f/s handoffs=%lu wakeups=%lu\n",
+            batch, conns, rounds, done, done / seconds, (unsigned long)handoffs, (unsigned long)wakeups);
+    return 0;
+}
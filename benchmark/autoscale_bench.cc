@@ -0,0 +1,161 @@
+/*
+subloop自动扩缩容的事件流
+用法: ./autoscale_bench [最少subloop数] [最多subloop数] [每个请求的计算时间us] [每阶段秒数] [排空秒数]
+负载分三个阶段: 空闲 -> 多个客户端持续请求 -> 请求客户端全部断开, 服务器打印每一次扩缩容决策
+请求在IO线程内计算, 客户端越多subloop越忙; 每个请求客户端还带一条从不关闭的空闲连接,
+退役的subloop超过排空时间后Shutdown, 再过一个排空时间ForceClose这些连接, 之后被回收
+服务器的日志较多, 运行时建议把stdout重定向到/dev/null, 结果输出到stderr
+*/
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/Logger.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <signal.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <netinet/tcp.h>
+
+using Clock = std::chrono::steady_clock;
+
+static const uint16_t kPort = 9536;
+static const size_t kMsgSize = 16;
+static const int kClients = 8;
+
+static void Spin(int us)
+{
+    Clock::time_point end = Clock::now() + std::chrono::microseconds(us);
+    while (Clock::now() < end) {}
+}
+
+static int Connect()
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(kPort);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    if (connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0)
+    {
+        perror("connect");
+        exit(1);
+    }
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    return fd;
+}
+
+static void Client(Clock::time_point deadline, std::atomic<long>* total)
+{
+    int fd = Connect();
+    char msg[kMsgSize];
+    memset(msg, 'w', sizeof(msg));
+    long done = 0;
+    while (Clock::now() < deadline)
+    {
+        if (write(fd, msg, sizeof(msg)) != static_cast<ssize_t>(sizeof(msg)))
+        {
+            break;
+        }
+        size_t got = 0;
+        while (got < sizeof(msg))
+        {
+            ssize_t n = read(fd, msg + got, sizeof(msg) - got);
+            if (n <= 0)
+            {
+                close(fd);
+                return;
+            }
+            got += n;
+        }
+        done++;
+    }
+    close(fd);
+    *total += done;
+}
+
+int main(int argc, char* argv[])
+{
+    int min_threads = argc > 1 ? atoi(argv[1]) : 1;
+    int max_threads = argc > 2 ? atoi(argv[2]) : 4;
+    int work_us = argc > 3 ? atoi(argv[3]) : 200;
+    int seconds = argc > 4 ? atoi(argv[4]) : 3;
+    double drain = argc > 5 ? atof(argv[5]) : 1.0;
+
+    signal(SIGPIPE, SIG_IGN);
+
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort), "AutoScaleBench");
+    server.SetThreadNum(min_threads);
+    server.SetPlacementPolicy(EventLoopThreadPool::kLeastConnections);
+    // 采样间隔0.2s, 连续2次超过/低于阈值才扩缩容
+    server.SetAutoScale(min_threads, max_threads, 600, 200, 0.2, 2);
+    server.SetRetireDrainTimeout(drain);
+
+    Clock::time_point begin = Clock::now();
+    server.SetScaleCallback([begin](const EventLoopThreadPool::ScaleEvent& event) {
+        static const char* kActions[] = {"scale-up", "scale-down", "retired"};
+        fprintf(stderr, "t=%5.2fs %-10s loop=%p active=%d retiring=%d busy=%d permille\n",
+                std::chrono::duration<double>(Clock::now() - begin).count(), kActions[event.action],
+                event.loop, event.ActiveLoops, event.RetiringLoops, event.AverageBusyPermille);
+    });
+    server.SetConnectionCallback([](const TcpConnectionPtr& conn) {
+        if (conn->Connected())
+        {
+            conn->SetTcpNoDelay(true);
+        }
+    });
+    server.SetMessageCallback([=](const TcpConnectionPtr& conn, Buffer* buf, TimeStamp) {
+        while (buf->ReadableBytes() >= kMsgSize)
+        {
+            std::string msg(buf->Peek(), kMsgSize);
+            buf->Retrieve(kMsgSize);
+            Spin(work_us);
+            conn->Send(msg);
+        }
+    });
+    server.Start();
+
+    std::thread driver([&]() {
+        fprintf(stderr, "phase 1: idle, %d subloops\n", min_threads);
+        sleep(seconds);
+
+        // 客户端分批连接, 扩容之后的连接才能分配到新的subloop
+        fprintf(stderr, "phase 2: %d clients, %dus per request\n", kClients, work_us);
+        std::atomic<long> total(0);
+        Clock::time_point deadline = Clock::now() + std::chrono::seconds(seconds);
+        std::vector<std::thread> threads;
+        std::vector<int> idle_fds;
+        for (int i = 0; i < kClients; i++)
+        {
+            threads.emplace_back(Client, deadline, &total);
+            idle_fds.push_back(Connect());
+            usleep(seconds * 1000 * 1000 / kClients / 2);
+        }
+        for (std::thread& t : threads)
+        {
+            t.join();
+        }
+        fprintf(stderr, "requests=%.0f/s\n", static_cast<double>(total.load()) / seconds);
+
+        // 空闲连接不读也不关闭, 退役的subloop只能靠排空关闭它们
+        fprintf(stderr, "phase 3: idle, %lu long-lived connections kept open\n", (unsigned long)idle_fds.size());
+        usleep(static_cast<useconds_t>((seconds + 2 * drain) * 1000 * 1000));
+        for (int fd : idle_fds)
+        {
+            close(fd);
+        }
+        loop.Quit();
+    });
+
+    loop.Loop();
+    driver.join();
+    return 0;
+}
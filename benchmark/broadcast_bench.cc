@@ -0,0 +1,105 @@
+/*
+向所有loop广播回调: 逐个loop RunInLoop vs EventLoopThreadPool::RunInAllLoops
+用法: ./broadcast_bench [subloop数] [每批广播数] [批数] [配置大小(字节)]
+每次广播携带一份配置, 统计配置被复制的次数, 总耗时(到所有loop都执行完), 以及各loop实际写eventfd的次数
+*/
+#include <mymuduo/EventLoop.h>
+#include <mymuduo/EventLoopThreadPool.h>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <stdio.h>
+#include <stdlib.h>
+
+using Clock = std::chrono::steady_clock;
+
+static std::atomic<long> g_Copies(0);
+
+// 广播的配置, 记录被复制的次数
+struct Config
+{
+    explicit Config(size_t size): data(size, 'c') {}
+    Config(const Config& other): data(other.data) { ++g_Copies; }
+    Config(Config&&) = default;
+
+    std::string data;
+};
+
+static uint64_t TotalWakeups(const std::vector<EventLoop*>& loops)
+{
+    uint64_t total = 0;
+    for (EventLoop* loop : loops)
+    {
+        total += loop->WakeupWrites();
+    }
+    return total;
+}
+
+int main(int argc, char* argv[])
+{
+    int threads = argc > 1 ? atoi(argv[1]) : 4;
+    int burst = argc > 2 ? atoi(argv[2]) : 100;
+    int rounds = argc > 3 ? atoi(argv[3]) : 100;
+    size_t size = argc > 4 ? atoi(argv[4]) : 4096;
+
+    EventLoop base;
+    EventLoopThreadPool pool(&base, "BroadcastBench");
+    pool.SetThreadNum(threads);
+    pool.Start();
+    std::vector<EventLoop*> loops = pool.GetAllLoops();
+
+    std::thread driver([&]() {
+        Config config(size);
+        std::atomic<long> applied(0);
+        long expected = static_cast<long>(burst) * rounds * threads;
+
+        // 改造前的做法: 每个loop一份std::function, 同一批广播之后等待所有loop执行完
+        g_Copies = 0;
+        uint64_t wakeups = TotalWakeups(loops);
+        Clock::time_point start = Clock::now();
+        for (int r = 0; r < rounds; r++)
+        {
+            for (int i = 0; i < burst; i++)
+            {
+                std::function<void()> fn = [config, &applied]() { applied += config.data.size() > 0; };
+                for (EventLoop* loop : loops)
+                {
+                    loop->RunInLoop(fn);
+                }
+            }
+            while (applied.load() < static_cast<long>(burst) * (r + 1) * threads) {}
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        fprintf(stderr, "RunInLoop     broadcasts=%d time=%.1fms config_copies=%ld wakeups=%lu\n",
+                burst * rounds, seconds * 1000, g_Copies.load(), (unsigned long)(TotalWakeups(loops) - wakeups));
+
+        // RunInAllLoops: 每次广播只有一份fn, 每批最后一次广播用done等待
+        applied = 0;
+        g_Copies = 0;
+        wakeups = TotalWakeups(loops);
+        start = Clock::now();
+        for (int r = 0; r < rounds; r++)
+        {
+            for (int i = 0; i < burst - 1; i++)
+            {
+                pool.RunInAllLoops([config, &applied]() { applied += config.data.size() > 0; });
+            }
+            pool.RunInAllLoopsAndWait([config, &applied]() { applied += config.data.size() > 0; });
+        }
+        seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        // 同一个loop上的回调按顺序执行, 最后一次广播完成时该批的广播都已执行
+        fprintf(stderr, "RunInAllLoops broadcasts=%d time=%.1fms config_copies=%ld wakeups=%lu applied=%s\n",
+                burst * rounds, seconds * 1000, g_Copies.load(), (unsigned long)(TotalWakeups(loops) - wakeups),
+                applied.load() == expected ? "ok" : "MISSING");
+        base.Quit();
+    });
+
+    base.Loop();
+    driver.join();
+    return 0;
+}
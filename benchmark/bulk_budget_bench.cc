@@ -0,0 +1,129 @@
+/*
+kBulk回调的时间预算对IO延迟的影响
+用法: ./bulk_budget_bench [预算us, 0表示不限制] [每批回调数] [每个回调的耗时us] [秒数]
+一个线程不断向loop成批投递kBulk回调, 同时ping客户端每1ms发一个请求, 统计往返延迟
+不限制预算时一整批回调执行完才轮到IO事件, 限制预算后每一轮最多执行预算时间的回调
+服务器的日志较多, 运行时建议把stdout重定向到/dev/null, 结果输出到stderr
+*/
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/Logger.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <signal.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <netinet/tcp.h>
+
+using Clock = std::chrono::steady_clock;
+
+static const uint16_t kPort = 9537;
+
+static void Spin(int us)
+{
+    Clock::time_point end = Clock::now() + std::chrono::microseconds(us);
+    while (Clock::now() < end) {}
+}
+
+static int Connect()
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(kPort);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    if (connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0)
+    {
+        perror("connect");
+        exit(1);
+    }
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    return fd;
+}
+
+int main(int argc, char* argv[])
+{
+    int budget_us = argc > 1 ? atoi(argv[1]) : 0;
+    int batch = argc > 2 ? atoi(argv[2]) : 2000;
+    int work_us = argc > 3 ? atoi(argv[3]) : 5;
+    int seconds = argc > 4 ? atoi(argv[4]) : 3;
+
+    signal(SIGPIPE, SIG_IGN);
+
+    // 只有BaseLoop, 回调和连接在同一个loop中处理
+    EventLoop loop;
+    loop.SetBulkBudget(budget_us);
+    TcpServer server(&loop, InetAddress(kPort), "BulkBudgetBench");
+    server.SetConnectionCallback([](const TcpConnectionPtr& conn) {
+        if (conn->Connected())
+        {
+            conn->SetTcpNoDelay(true);
+        }
+    });
+    server.SetMessageCallback([](const TcpConnectionPtr& conn, Buffer* buf, TimeStamp) {
+        conn->Send(buf->RetrieveAllAsString());
+    });
+    server.Start();
+
+    std::atomic_bool running(true);
+    std::atomic<long> executed(0);
+    std::vector<double> latencies;
+    std::thread flooder([&]() {
+        usleep(100 * 1000);
+        while (running)
+        {
+            // 上一批执行完再投递下一批, loop的回调队列不会无限增长
+            if (executed.load() % batch == 0)
+            {
+                for (int i = 0; i < batch; i++)
+                {
+                    loop.QueneInLoop([&executed, work_us]() {
+                        Spin(work_us);
+                        ++executed;
+                    }, EventLoop::kBulk);
+                }
+            }
+            usleep(1000);
+        }
+    });
+    std::thread pinger([&]() {
+        usleep(100 * 1000);
+        int fd = Connect();
+        Clock::time_point deadline = Clock::now() + std::chrono::seconds(seconds);
+        char c = 'p';
+        while (Clock::now() < deadline)
+        {
+            Clock::time_point start = Clock::now();
+            if (write(fd, &c, 1) != 1 || read(fd, &c, 1) != 1)
+            {
+                break;
+            }
+            latencies.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+            usleep(1000);
+        }
+        close(fd);
+        running = false;
+
+        std::sort(latencies.begin(), latencies.end());
+        size_t n = latencies.size();
+        fprintf(stderr, "budget=%dus batch=%d work=%dus bulk=%.0f/s rollovers=%lu ping p50=%.0fus p99=%.0fus max=%.0fus\n",
+                budget_us, batch, work_us, static_cast<double>(executed.load()) / seconds,
+                (unsigned long)loop.BulkRollovers(), n > 0 ? latencies[n / 2] : 0.0,
+                n > 0 ? latencies[n * 99 / 100] : 0.0, n > 0 ? latencies[n - 1] : 0.0);
+        loop.Quit();
+    });
+
+    loop.Loop();
+    flooder.join();
+    pinger.join();
+    return 0;
+}
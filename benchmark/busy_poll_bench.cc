@@ -0,0 +1,111 @@
+/*
+busy poll模式对请求往返延迟的影响
+用法: ./busy_poll_bench [on|off] [请求数] [请求间隔us] [自旋预算us]
+服务器使用一个subloop, 客户端在一条连接上按固定间隔发送64字节请求, 统计往返延迟分位数
+*/
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/Logger.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <netinet/tcp.h>
+
+using Clock = std::chrono::steady_clock;
+
+static const uint16_t kPort = 9531;
+static const size_t kMsgSize = 64;
+
+static void Client(int samples, int interval_us, std::vector<double>* latencies)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(kPort);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    if (connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0)
+    {
+        perror("connect");
+        exit(1);
+    }
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+    char msg[kMsgSize];
+    memset(msg, 'x', sizeof(msg));
+    for (int i = 0; i < samples; i++)
+    {
+        Clock::time_point start = Clock::now();
+        if (write(fd, msg, sizeof(msg)) != sizeof(msg))
+        {
+            break;
+        }
+        size_t got = 0;
+        while (got < sizeof(msg))
+        {
+            ssize_t n = read(fd, msg + got, sizeof(msg) - got);
+            if (n <= 0)
+            {
+                close(fd);
+                return;
+            }
+            got += n;
+        }
+        latencies->push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+        if (interval_us > 0)
+        {
+            usleep(interval_us);
+        }
+    }
+    close(fd);
+}
+
+int main(int argc, char* argv[])
+{
+    bool busy = argc > 1 && std::string(argv[1]) == "on";
+    int samples = argc > 2 ? atoi(argv[2]) : 20000;
+    int interval_us = argc > 3 ? atoi(argv[3]) : 50;
+    int spin_us = argc > 4 ? atoi(argv[4]) : 1000;
+
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort), "BusyPollBench");
+    server.SetThreadNum(1);
+    if (busy)
+    {
+        server.SetBusyPoll(spin_us, spin_us);
+    }
+    server.SetConnectionCallback([](const TcpConnectionPtr&) {});
+    server.SetMessageCallback([](const TcpConnectionPtr& conn, Buffer* buf, TimeStamp) {
+        conn->Send(buf->RetrieveAllAsString());
+    });
+    server.Start();
+
+    std::vector<double> latencies;
+    latencies.reserve(samples);
+    std::thread driver([&]() {
+        usleep(100 * 1000);
+        Client(samples, interval_us, &latencies);
+        loop.Quit();
+    });
+
+    loop.Loop();
+    driver.join();
+
+    if (latencies.empty())
+    {
+        return 1;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    size_t n = latencies.size();
+    printf("busy_poll=%s spin=%dus interval=%dus samples=%lu p50=%.1fus p99=%.1fus p999=%.1fus\n",
+           busy ? "on" : "off", spin_us, interval_us, n,
+           latencies[n / 2], latencies[n * 99 / 100], latencies[n * 999 / 1000]);
+    return 0;
+}
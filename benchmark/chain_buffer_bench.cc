@@ -0,0 +1,91 @@
+/*
+大块响应在发送缓冲区中的开销: Buffer(vector) vs ChainBuffer(slab链)
+用法: ./chain_buffer_bench [响应大小MB] [每次追加KB] [每次发送KB] [响应个数]
+模拟应用追加响应的速度快于socket发送: 每追加一块只发送一部分, 追加完之后再把剩下的发送完
+发送用memcpy到一块固定内存模拟内核拷贝, 统计总耗时和缓冲区占用内存的峰值
+*/
+#include <mymuduo/Buffer.h>
+#include <mymuduo/ChainBuffer.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using Clock = std::chrono::steady_clock;
+
+static size_t Capacity(const Buffer& buf)
+{
+    return buf.PrependableBytes() + buf.ReadableBytes() + buf.WritableBytes();
+}
+
+static size_t Capacity(const ChainBuffer& buf)
+{
+    return buf.Capacity();
+}
+
+static size_t ContiguousBytes(const Buffer& buf)
+{
+    return buf.ReadableBytes();
+}
+
+static size_t ContiguousBytes(const ChainBuffer& buf)
+{
+    return buf.ContiguousBytes();
+}
+
+static std::vector<char> g_Sink;
+
+// 模拟一次socket可写事件: 内核最多接收limit字节
+template <typename BufferT>
+static void Send(BufferT* buf, size_t limit)
+{
+    size_t sent = 0;
+    while (sent < limit && buf->ReadableBytes() > 0)
+    {
+        size_t n = std::min(limit - sent, ContiguousBytes(*buf));
+        memcpy(g_Sink.data(), buf->Peek(), n);
+        buf->Retrieve(n);
+        sent += n;
+    }
+}
+
+template <typename BufferT>
+static void Run(const char* name, size_t response, size_t chunk, size_t send, int count)
+{
+    std::string data(chunk, 'x');
+    BufferT buf;
+    size_t peak = 0;
+    Clock::time_point start = Clock::now();
+    for (int r = 0; r < count; r++)
+    {
+        for (size_t appended = 0; appended < response; appended += chunk)
+        {
+            buf.Append(data.data(), data.size());
+            peak = std::max(peak, Capacity(buf));
+            Send(&buf, send);
+        }
+        while (buf.ReadableBytes() > 0)
+        {
+            Send(&buf, send);
+        }
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    fprintf(stderr, "%-12s time=%.1fms throughput=%.0fMB/s peak_memory=%.1fMB\n", name, seconds * 1000,
+            static_cast<double>(response) * count / seconds / (1 << 20), static_cast<double>(peak) / (1 << 20));
+}
+
+int main(int argc, char* argv[])
+{
+    size_t response = (argc > 1 ? atoi(argv[1]) : 16) << 20;
+    size_t chunk = (argc > 2 ? atoi(argv[2]) : 64) << 10;
+    size_t send = (argc > 3 ? atoi(argv[3]) : 32) << 10;
+    int count = argc > 4 ? atoi(argv[4]) : 10;
+
+    g_Sink.resize(send);
+    Run<Buffer>("Buffer", response, chunk, send, count);
+    Run<ChainBuffer>("ChainBuffer", response, chunk, send, count);
+    return 0;
+}
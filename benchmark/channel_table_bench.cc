@@ -0,0 +1,138 @@
+/*
+Poller中fd到Channel映射的内存占用和操作吞吐: ChannelTable对比原来的unordered_map
+用法: ./channel_table_bench [fd数量...]  默认100000和1000000
+每种结构在单独的子进程中测量, RSS增量不受前一次测量释放的内存影响
+*/
+#include <mymuduo/ChannelTable.h>
+#include <unordered_map>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+static double ElapsedNs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+static long RssKb()
+{
+    long pages = 0, resident = 0;
+    FILE* fp = fopen("/proc/self/statm", "r");
+    if (fp != nullptr)
+    {
+        if (fscanf(fp, "%ld %ld", &pages, &resident) != 2)
+        {
+            resident = 0;
+        }
+        fclose(fp);
+    }
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+// 与Poller中的用法一致的最小接口
+struct MapAdapter
+{
+    std::unordered_map<int, Channel*> map;
+    Channel* Find(int fd) const
+    {
+        auto it = map.find(fd);
+        return it == map.end() ? nullptr : it->second;
+    }
+    void Insert(int fd, Channel* channel) { map[fd] = channel; }
+    void Erase(int fd) { map.erase(fd); }
+};
+
+struct TableAdapter
+{
+    ChannelTable table;
+    Channel* Find(int fd) const { return table.Find(fd); }
+    void Insert(int fd, Channel* channel) { table.Insert(fd, channel); }
+    void Erase(int fd) { table.Erase(fd); }
+};
+
+template <typename Adapter>
+static void Run(const char* name, int fds)
+{
+    std::vector<int> order(fds);
+    std::mt19937 rng(42);
+    for (int i = 0; i < fds; i++)
+    {
+        order[i] = rng() % fds;
+    }
+    Channel* dummy = reinterpret_cast<Channel*>(&order);
+
+    long rss_before = RssKb();
+    Adapter* adapter = new Adapter();
+
+    // fd由内核从小到大分配, 按顺序注册
+    auto start = std::chrono::steady_clock::now();
+    for (int fd = 0; fd < fds; fd++)
+    {
+        adapter->Insert(fd, dummy);
+    }
+    double insert_ns = ElapsedNs(start) / fds;
+    long rss_kb = RssKb() - rss_before;
+
+    // HasChannel
+    long hits = 0;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < fds; i++)
+    {
+        hits += adapter->Find(order[i]) == dummy;
+    }
+    double find_ns = ElapsedNs(start) / fds;
+
+    // 连接关闭后fd被复用: Remove后立即重新注册
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < fds; i++)
+    {
+        adapter->Erase(order[i]);
+        adapter->Insert(order[i], dummy);
+    }
+    double churn_ns = ElapsedNs(start) / fds;
+
+    printf("%-14s fds=%8d  rss=%8ld KB (%5.1f B/fd)  insert=%6.1f Mops/s  find=%6.1f Mops/s  remove+add=%6.1f Mops/s  hits=%ld\n",
+           name, fds, rss_kb, rss_kb * 1024.0 / fds,
+           1000.0 / insert_ns, 1000.0 / find_ns, 1000.0 / churn_ns, hits);
+    delete adapter;
+}
+
+template <typename Adapter>
+static void RunInChild(const char* name, int fds)
+{
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        Run<Adapter>(name, fds);
+        fflush(stdout);
+        _exit(0);
+    }
+    waitpid(pid, nullptr, 0);
+}
+
+int main(int argc, char* argv[])
+{
+    std::vector<int> sizes;
+    for (int i = 1; i < argc; i++)
+    {
+        sizes.push_back(atoi(argv[i]));
+    }
+    if (sizes.empty())
+    {
+        sizes.push_back(100000);
+        sizes.push_back(1000000);
+    }
+
+    for (int fds : sizes)
+    {
+        RunInChild<MapAdapter>("unordered_map", fds);
+        RunInChild<TableAdapter>("ChannelTable", fds);
+    }
+    return 0;
+}
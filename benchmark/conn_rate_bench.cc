@@ -0,0 +1,101 @@
+/*
+新建连接速率: BaseLoop单个Acceptor对比每个subloop一个SO_REUSEPORT Acceptor
+用法: ./conn_rate_bench [single|reuseport] [subloop数] [客户端线程数] [秒数]
+客户端反复connect, 读到服务器在连接建立时发送的1个字节后用RST关闭(避免TIME_WAIT耗尽端口)
+服务器的日志较多, 运行时建议把stdout重定向到/dev/null, 结果输出到stderr
+*/
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/Logger.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <signal.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+static const uint16_t kPort = 9533;
+
+static void Client(int seconds, std::atomic<long>* total)
+{
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(kPort);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+
+    linger lg;
+    lg.l_onoff = 1;
+    lg.l_linger = 0;
+
+    long conns = 0;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+    while (std::chrono::steady_clock::now() < deadline)
+    {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0)
+        {
+            close(fd);
+            continue;
+        }
+        char c;
+        if (read(fd, &c, 1) == 1)
+        {
+            ++conns;
+        }
+        setsockopt(fd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+        close(fd);
+    }
+    *total += conns;
+}
+
+int main(int argc, char* argv[])
+{
+    bool reuseport = argc > 1 && std::string(argv[1]) == "reuseport";
+    int threads = argc > 2 ? atoi(argv[2]) : 4;
+    int clients = argc > 3 ? atoi(argv[3]) : 8;
+    int seconds = argc > 4 ? atoi(argv[4]) : 3;
+
+    signal(SIGPIPE, SIG_IGN);
+
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort), "ConnRateBench",
+                     reuseport ? TcpServer::kReusePort : TcpServer::kNoReusePort);
+    server.SetThreadNum(threads);
+    server.SetConnectionCallback([](const TcpConnectionPtr& conn) {
+        if (conn->Connected())
+        {
+            conn->Send("x");
+        }
+    });
+    server.SetMessageCallback([](const TcpConnectionPtr&, Buffer* buf, TimeStamp) { buf->RetrieveAll(); });
+    server.Start();
+
+    std::atomic<long> total(0);
+    std::thread driver([&]() {
+        usleep(100 * 1000);
+        std::vector<std::thread> workers;
+        for (int i = 0; i < clients; i++)
+        {
+            workers.emplace_back(Client, seconds, &total);
+        }
+        for (std::thread& t : workers)
+        {
+            t.join();
+        }
+        loop.Quit();
+    });
+
+    loop.Loop();
+    driver.join();
+
+    fprintf(stderr, "mode=%s subloops=%d clients=%d connections=%ld rate=%.0f/s\n",
+            reuseport ? "reuseport" : "single", threads, clients, total.load(),
+            static_cast<double>(total.load()) / seconds);
+    return 0;
+}
@@ -0,0 +1,167 @@
+/*
+同一个两段式协议分别用回调和协程实现的服务器对比, 需要C++20编译
+用法: ./coroutine_bench [callback|coroutine] [客户端数] [请求体字节数] [流水线深度] [秒数]
+请求: "LEN <n>\r\n" + n字节请求体, 回复: 原样返回请求体
+回调版本在MessageCallback中解析缓冲区, 请求不完整时留到下次; 协程版本依次co_await ReadUntil/Read/Write
+客户端也是协程: co_await Connector::AsyncConnect建立连接, 按流水线深度发请求并读取回复
+服务器的日志较多, 运行时建议把stdout重定向到/dev/null, 结果输出到stderr
+*/
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/EventLoopThread.h>
+#include <mymuduo/Coroutine.h>
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+
+using Clock = std::chrono::steady_clock;
+
+static const uint16_t kPort = 9538;
+
+struct Stats
+{
+    std::atomic<long> requests{0};
+    std::atomic<long> errors{0};
+    std::atomic<int> finished{0};
+};
+
+// 回调版本: 每次收到数据都从头解析, 不完整的请求留在缓冲区中
+static void OnMessage(const TcpConnectionPtr& conn, Buffer* buf, TimeStamp)
+{
+    while (true)
+    {
+        const char* begin = buf->Peek();
+        const char* end = begin + buf->ReadableBytes();
+        const char* crlf = static_cast<const char*>(memmem(begin, end - begin, "\r\n", 2));
+        if (crlf == nullptr)
+        {
+            return;
+        }
+        size_t len = strtoul(begin + 4, nullptr, 10);
+        size_t header = crlf + 2 - begin;
+        if (buf->ReadableBytes() < header + len)
+        {
+            return;
+        }
+        buf->Retrieve(header);
+        conn->Send(buf->RetrieveAsString(len));
+    }
+}
+
+// 协程版本
+static CoTask<> Session(TcpConnectionPtr conn)
+{
+    while (true)
+    {
+        std::string header = co_await conn->ReadUntil("\r\n");
+        if (!conn->Connected())
+        {
+            break;
+        }
+        std::string body = co_await conn->Read(strtoul(header.c_str() + 4, nullptr, 10));
+        if (!co_await conn->Write(body))
+        {
+            break;
+        }
+    }
+}
+
+static CoTask<> Client(EventLoop* loop, int index, size_t size, int depth, Clock::time_point deadline, Stats* stats)
+{
+    co_await loop->Sleep(index); // 错开连接
+    TcpConnectionPtr conn = co_await Connector::AsyncConnect(loop, InetAddress(kPort));
+    if (!conn)
+    {
+        ++stats->errors;
+        ++stats->finished;
+        co_return;
+    }
+    conn->SetTcpNoDelay(true);
+
+    std::string request = "LEN " + std::to_string(size) + "\r\n" + std::string(size, 'x');
+    std::string pipeline;
+    for (int i = 0; i < depth; i++)
+    {
+        pipeline += request;
+    }
+    while (Clock::now() < deadline)
+    {
+        co_await conn->Write(pipeline);
+        for (int i = 0; i < depth; i++)
+        {
+            std::string reply = co_await conn->Read(size);
+            if (reply.size() != size)
+            {
+                ++stats->errors;
+                ++stats->finished;
+                co_return;
+            }
+        }
+        stats->requests += depth;
+    }
+    // 等服务器关闭连接之后再结束, Read在连接断开时返回
+    conn->Shutdown();
+    co_await conn->Read(1);
+    ++stats->finished;
+}
+
+int main(int argc, char* argv[])
+{
+    std::string mode = argc > 1 ? argv[1] : "coroutine";
+    int clients = argc > 2 ? atoi(argv[2]) : 16;
+    size_t size = argc > 3 ? atoi(argv[3]) : 128;
+    int depth = argc > 4 ? atoi(argv[4]) : 4;
+    int seconds = argc > 5 ? atoi(argv[5]) : 3;
+
+    signal(SIGPIPE, SIG_IGN);
+
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort), "CoroutineBench");
+    server.SetThreadNum(1);
+    if (mode == "coroutine")
+    {
+        server.SetConnectionCallback([](const TcpConnectionPtr& conn) {
+            if (conn->Connected())
+            {
+                conn->SetTcpNoDelay(true);
+                CoSpawn(Session(conn));
+            }
+        });
+    }
+    else
+    {
+        server.SetConnectionCallback([](const TcpConnectionPtr& conn) {
+            if (conn->Connected())
+            {
+                conn->SetTcpNoDelay(true);
+            }
+        });
+        server.SetMessageCallback(OnMessage);
+    }
+    server.Start();
+
+    EventLoopThread client_thread(EventLoopThread::ThreadInitCallback(), "BenchClient");
+    EventLoop* client_loop = client_thread.StartLoop();
+    Stats stats;
+    Clock::time_point deadline = Clock::now() + std::chrono::seconds(seconds);
+    for (int i = 0; i < clients; i++)
+    {
+        client_loop->RunInLoop([=, &stats]() { CoSpawn(Client(client_loop, i, size, depth, deadline, &stats)); });
+    }
+
+    loop.RunEvery(0.1, [&]() {
+        if (stats.finished.load() == clients)
+        {
+            fprintf(stderr, "mode=%s clients=%d size=%lu depth=%d requests=%.0f/s errors=%ld\n",
+                    mode.c_str(), clients, (unsigned long)size, depth,
+                    static_cast<double>(stats.requests.load()) / seconds, stats.errors.load());
+            loop.Quit();
+        }
+    });
+    loop.Loop();
+    return 0;
+}
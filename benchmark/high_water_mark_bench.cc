@@ -0,0 +1,119 @@
+/*
+输出缓冲区高水位回调的触发次数
+用法: ./high_water_mark_bench [高水位MB] [每轮发送MB] [轮数]
+客户端每轮发一个字节请求, 服务器收到后用64KB的Send连续发送一轮数据, 客户端先不读, 数据积压在输出缓冲区中
+每一轮输出缓冲区越过高水位一次, HighWaterMarkCallback应该正好执行一次; 客户端读完一轮之后再开始下一轮
+服务器的日志较多, 运行时建议把stdout重定向到/dev/null, 结果输出到stderr
+*/
+#include <mymuduo/TcpServer.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <signal.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+static const uint16_t kPort = 9542;
+static const size_t kChunkSize = 64 * 1024;
+
+int main(int argc, char* argv[])
+{
+    size_t mark = static_cast<size_t>(argc > 1 ? atoi(argv[1]) : 8) << 20;
+    size_t round_size = static_cast<size_t>(argc > 2 ? atoi(argv[2]) : 32) << 20;
+    int rounds = argc > 3 ? atoi(argv[3]) : 3;
+    signal(SIGPIPE, SIG_IGN);
+
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort), "HighWaterMarkBench");
+    server.SetThreadNum(1);
+
+    // 回调都在同一个subloop中执行
+    std::atomic<int> callbacks(0);
+    std::atomic<size_t> min_len(0);
+    server.SetConnectionCallback([&](const TcpConnectionPtr& conn) {
+        if (conn->Connected())
+        {
+            conn->SetHighWaterMark(mark);
+            conn->SetHighWaterMarkCallback([&](const TcpConnectionPtr&, size_t len) {
+                ++callbacks;
+                if (min_len.load() == 0 || len < min_len.load())
+                {
+                    min_len = len;
+                }
+            });
+        }
+    });
+    std::string chunk(kChunkSize, 'h');
+    server.SetMessageCallback([&](const TcpConnectionPtr& conn, Buffer* buf, TimeStamp) {
+        for (size_t i = 0; i < buf->ReadableBytes(); i++)
+        {
+            for (size_t sent = 0; sent < round_size; sent += kChunkSize)
+            {
+                conn->Send(chunk);
+            }
+        }
+        buf->RetrieveAll();
+    });
+    server.Start();
+
+    std::vector<int> per_round;
+    std::thread driver([&]() {
+        usleep(100 * 1000);
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(kPort);
+        addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0)
+        {
+            fprintf(stderr, "connect failed: %s\n", strerror(errno));
+            close(fd);
+            loop.Quit();
+            return;
+        }
+
+        std::vector<char> data(kChunkSize);
+        for (int r = 0; r < rounds; r++)
+        {
+            int before = callbacks.load();
+            if (write(fd, "g", 1) != 1)
+            {
+                break;
+            }
+            usleep(200 * 1000); // 不读, 让数据积压在服务器的输出缓冲区中
+            size_t left = round_size;
+            while (left > 0)
+            {
+                ssize_t n = read(fd, data.data(), std::min(left, data.size()));
+                if (n <= 0)
+                {
+                    break;
+                }
+                left -= n;
+            }
+            usleep(50 * 1000);
+            per_round.push_back(callbacks.load() - before);
+        }
+        close(fd);
+        usleep(100 * 1000);
+        loop.Quit();
+    });
+
+    loop.Loop();
+    driver.join();
+
+    fprintf(stderr, "high_water_mark=%luMB round=%luMB rounds=%d callbacks=%d min_len=%.1fMB\n",
+            (unsigned long)mark >> 20, (unsigned long)round_size >> 20, rounds, callbacks.load(),
+            static_cast<double>(min_len.load()) / (1 << 20));
+    for (size_t r = 0; r < per_round.size(); r++)
+    {
+        fprintf(stderr, "  round %lu: callbacks=%d (expected 1)\n", (unsigned long)r, per_round[r]);
+    }
+    return 0;
+}
@@ -0,0 +1,179 @@
+/*
+大量空闲连接占用的内存(RSS)
+用法: ./idle_memory_bench [连接数] [收缩空闲秒数] [突发数据KB]
+依次测量服务器在几个阶段每个连接平均增加的RSS:
+  idle:    连接建立之后没有任何数据
+  echo:    每个连接收发一次4KB的请求/回复之后
+  partial: 每个连接收到一次突发数据(默认256KB), 服务器按1KB记录消费, 留下100字节不完整的记录
+  shrink:  partial之后等待连接空闲超过收缩时间
+客户端和服务器在同一个进程中, 客户端直接使用阻塞socket, 不占用用户态缓冲区
+单个进程的fd上限需要大于连接数的2倍, 服务器的日志较多, 运行时建议把stdout重定向到/dev/null, 结果输出到stderr
+*/
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/Logger.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <signal.h>
+#include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+static const uint16_t kPort = 9540;
+static const size_t kRecordSize = 1024;
+static const size_t kRequestSize = 4096;
+
+static long ResidentBytes()
+{
+    long size = 0;
+    long resident = 0;
+    FILE* fp = fopen("/proc/self/statm", "r");
+    if (fp != nullptr)
+    {
+        if (fscanf(fp, "%ld %ld", &size, &resident) != 2)
+        {
+            resident = 0;
+        }
+        fclose(fp);
+    }
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+static bool WriteAll(int fd, const char* data, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = write(fd, data, len);
+        if (n <= 0)
+        {
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+static bool ReadAll(int fd, char* data, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = read(fd, data, len);
+        if (n <= 0)
+        {
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    int conns = argc > 1 ? atoi(argv[1]) : 5000;
+    double shrink = argc > 2 ? atof(argv[2]) : 1.0;
+    size_t burst_size = (argc > 3 ? atoi(argv[3]) : 256) * 1024 + 100;
+
+    signal(SIGPIPE, SIG_IGN);
+
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort), "IdleMemoryBench");
+    server.SetThreadNum(1);
+    server.SetBufferShrinkIdle(shrink);
+    std::atomic<int> connected(0);
+    server.SetConnectionCallback([&connected](const TcpConnectionPtr& conn) {
+        if (conn->Connected())
+        {
+            ++connected;
+        }
+    });
+    // 4KB的请求原样返回; 其余数据按1KB记录消费, 不完整的记录留在缓冲区中
+    server.SetMessageCallback([](const TcpConnectionPtr& conn, Buffer* buf, TimeStamp) {
+        if (buf->ReadableBytes() == kRequestSize)
+        {
+            conn->Send(buf->RetrieveAllAsString());
+        }
+        else if (buf->ReadableBytes() > kRequestSize)
+        {
+            buf->Retrieve(buf->ReadableBytes() / kRecordSize * kRecordSize);
+        }
+    });
+    server.Start();
+
+    std::thread driver([&]() {
+        usleep(100 * 1000);
+        long base = ResidentBytes();
+        auto report = [&](const char* phase) {
+            usleep(500 * 1000);
+            long rss = ResidentBytes();
+            fprintf(stderr, "%-8s rss=%.1fMB per_connection=%.0fB\n", phase, static_cast<double>(rss) / (1 << 20),
+                    static_cast<double>(rss - base) / conns);
+        };
+
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(kPort);
+        addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+        std::vector<int> fds;
+        for (int i = 0; i < conns; i++)
+        {
+            int fd = socket(AF_INET, SOCK_STREAM, 0);
+            if (connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0)
+            {
+                fprintf(stderr, "connect failed after %d connections: %s\n", i, strerror(errno));
+                close(fd);
+                break;
+            }
+            int on = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+            fds.push_back(fd);
+        }
+        conns = static_cast<int>(fds.size());
+        while (connected.load() < conns)
+        {
+            usleep(10 * 1000);
+        }
+        report("idle");
+
+        std::string request(kRequestSize, 'r');
+        std::vector<char> reply(kRequestSize);
+        for (int fd : fds)
+        {
+            if (!WriteAll(fd, request.data(), request.size()) || !ReadAll(fd, reply.data(), reply.size()))
+            {
+                fprintf(stderr, "echo failed\n");
+                break;
+            }
+        }
+        report("echo");
+
+        std::string burst(burst_size, 'b');
+        for (int fd : fds)
+        {
+            WriteAll(fd, burst.data(), burst.size());
+        }
+        report("partial");
+
+        // 时间轮的tick是1秒, 实际收缩时间最多多出2个tick
+        usleep(static_cast<useconds_t>((shrink + 2) * 1000 * 1000));
+        report("shrink");
+
+        for (int fd : fds)
+        {
+            close(fd);
+        }
+        loop.Quit();
+    });
+
+    loop.Loop();
+    driver.join();
+    fprintf(stderr, "connections=%d shrink_idle=%.1fs burst=%luB\n", conns, shrink, (unsigned long)burst_size);
+    return 0;
+}
@@ -0,0 +1,171 @@
+/*
+延迟合并interest变更的效果: 统计UpdateChannel次数和实际的epoll_ctl次数
+用法: ./interest_update_bench [echo|stream] [连接数] [秒数] [消息大小] [流水线深度]
+echo:   服务器把echo交给工作线程跨线程Send, 客户端做流水线请求
+stream: 服务器在WriteCompleteCallback中发送下一块数据, 客户端慢速读取
+HandleWrite中关闭EPOLLOUT后, 同一轮的回调又发送不完而重新打开, 这类来回变化会被抵消
+改造前每次UpdateChannel都对应一次epoll_ctl
+*/
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/EventLoopThread.h>
+#include <mymuduo/Logger.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <signal.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+static const uint16_t kPort = 9532;
+
+static int Connect()
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int rcvbuf = 4096;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(kPort);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    if (connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0)
+    {
+        perror("connect");
+        exit(1);
+    }
+    return fd;
+}
+
+static void Client(int seconds, size_t msg_size, int depth, std::atomic<long>* total)
+{
+    int fd = Connect();
+
+    // 一次写出depth个请求, 再读回全部响应
+    std::string batch(msg_size * depth, 'x');
+    std::vector<char> buf(batch.size());
+    long bytes = 0;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+    while (std::chrono::steady_clock::now() < deadline)
+    {
+        if (write(fd, batch.data(), batch.size()) != static_cast<ssize_t>(batch.size()))
+        {
+            break;
+        }
+        size_t got = 0;
+        while (got < batch.size())
+        {
+            ssize_t n = read(fd, &buf[got], batch.size() - got);
+            if (n <= 0)
+            {
+                close(fd);
+                *total += bytes;
+                return;
+            }
+            got += n;
+        }
+        bytes += got;
+    }
+    close(fd);
+    *total += bytes;
+}
+
+// 只读取服务器推送的数据, 到时间后发送一个字节通知服务器关闭
+static void StreamClient(int seconds, std::atomic<long>* total)
+{
+    int fd = Connect();
+    std::vector<char> buf(4096);
+    long bytes = 0;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+    while (std::chrono::steady_clock::now() < deadline)
+    {
+        ssize_t n = read(fd, buf.data(), buf.size());
+        if (n <= 0)
+        {
+            break;
+        }
+        bytes += n;
+    }
+    write(fd, "q", 1);
+    ssize_t n;
+    while ((n = read(fd, buf.data(), buf.size())) > 0) {}
+    close(fd);
+    *total += bytes;
+}
+
+int main(int argc, char* argv[])
+{
+    std::string mode = argc > 1 ? argv[1] : "echo";
+    int conns = argc > 2 ? atoi(argv[2]) : 4;
+    int seconds = argc > 3 ? atoi(argv[3]) : 3;
+    size_t msg_size = argc > 4 ? atol(argv[4]) : 4096;
+    int depth = argc > 5 ? atoi(argv[5]) : 16;
+    // 客户端关闭时服务器可能还有数据没写完
+    signal(SIGPIPE, SIG_IGN);
+
+    EventLoopThread worker_thread;
+    EventLoop* worker = worker_thread.StartLoop();
+
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort), "InterestBench");
+    const std::string chunk(msg_size * depth, 'y');
+    if (mode == "stream")
+    {
+        server.SetConnectionCallback([&chunk](const TcpConnectionPtr& conn) {
+            if (conn->Connected())
+            {
+                conn->Send(chunk);
+            }
+        });
+        server.SetWriteCompleteCallback([&chunk](const TcpConnectionPtr& conn) { conn->Send(chunk); });
+        server.SetMessageCallback([](const TcpConnectionPtr& conn, Buffer* buf, TimeStamp) {
+            buf->RetrieveAll();
+            conn->Shutdown();
+        });
+    }
+    else
+    {
+        server.SetConnectionCallback([](const TcpConnectionPtr&) {});
+        server.SetMessageCallback([worker](const TcpConnectionPtr& conn, Buffer* buf, TimeStamp) {
+            std::string msg = buf->RetrieveAllAsString();
+            worker->QueneInLoop([conn, msg]() { conn->Send(msg); });
+        });
+    }
+    server.Start();
+
+    std::atomic<long> total(0);
+    std::thread driver([&]() {
+        usleep(100 * 1000);
+        std::vector<std::thread> clients;
+        for (int i = 0; i < conns; i++)
+        {
+            if (mode == "stream")
+            {
+                clients.emplace_back(StreamClient, seconds, &total);
+            }
+            else
+            {
+                clients.emplace_back(Client, seconds, msg_size, depth, &total);
+            }
+        }
+        for (std::thread& t : clients)
+        {
+            t.join();
+        }
+        loop.Quit();
+    });
+
+    loop.Loop();
+    driver.join();
+
+    uint64_t changes = loop.InterestChanges();
+    uint64_t ops = loop.InterestOps();
+    printf("echoed=%.1f MB interest changes=%lu epoll_ctl=%lu avoided=%lu (%.1f%%)\n",
+           total.load() / 1048576.0, changes, ops, changes - ops,
+           changes ? 100.0 * (changes - ops) / changes : 0.0);
+    return 0;
+}
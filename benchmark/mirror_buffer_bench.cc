@@ -0,0 +1,190 @@
+/*
+长期半满的流式输入缓冲区: Buffer的vector存储 vs MirrorRing(双重映射的环)
+用法: ./mirror_buffer_bench buffer [积压KB] [总量MB]
+      ./mirror_buffer_bench stream [vector|mirror] [积压KB] [连接数] [秒数]
+消费者按1000字节的记录处理数据, 但总是留下积压KB的数据不处理(模拟等待后续数据才能解析的流),
+vector存储写到末尾时要把积压的数据复制回开头, 环不需要移动数据
+buffer: 单线程, 每次Append 64KB, 比较两种存储的耗时, 每条记录都校验内容
+stream: 真实的TcpServer, 客户端线程持续发送, 服务器按上面的方式消费并校验, 统计吞吐
+服务器的日志较多, 运行时建议把stdout重定向到/dev/null, 结果输出到stderr
+*/
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/Buffer.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <unordered_map>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <signal.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+using Clock = std::chrono::steady_clock;
+
+static const uint16_t kPort = 9541;
+static const size_t kRecordSize = 1000; // 不是页大小的约数, 记录会跨过环的绕回点
+static const size_t kChunkSize = 64 * 1024;
+static const size_t kPattern = 251; // 流中偏移o处的字节是o % 251
+
+static std::vector<char> g_Source;
+
+static void InitSource()
+{
+    g_Source.resize(kChunkSize + kPattern);
+    for (size_t i = 0; i < g_Source.size(); i++)
+    {
+        g_Source[i] = static_cast<char>(i % kPattern);
+    }
+}
+
+// 消费积压之外的完整记录, 返回内容不对的记录数
+static long Consume(Buffer* buf, size_t backlog, size_t* consumed)
+{
+    long errors = 0;
+    while (buf->ReadableBytes() >= backlog + kRecordSize)
+    {
+        if (memcmp(buf->Peek(), g_Source.data() + *consumed % kPattern, kRecordSize) != 0)
+        {
+            ++errors;
+        }
+        buf->Retrieve(kRecordSize);
+        *consumed += kRecordSize;
+    }
+    return errors;
+}
+
+static const char* BackendName(Buffer::Backend backend)
+{
+    return backend == Buffer::kMirrorBackend ? "mirror" : "vector";
+}
+
+static void RunBuffer(Buffer::Backend backend, size_t backlog, size_t total)
+{
+    Buffer buf(Buffer::kInitialSize, backend);
+    size_t written = 0;
+    size_t consumed = 0;
+    long errors = 0;
+    Clock::time_point start = Clock::now();
+    while (consumed < total)
+    {
+        buf.Append(g_Source.data() + written % kPattern, kChunkSize);
+        written += kChunkSize;
+        errors += Consume(&buf, backlog, &consumed);
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    fprintf(stderr, "%-6s backlog=%luKB consumed=%luMB time=%.1fms rate=%.0fMB/s capacity=%luKB errors=%ld\n",
+            BackendName(buf.GetBackend()), (unsigned long)backlog / 1024, (unsigned long)consumed >> 20,
+            seconds * 1000, consumed / seconds / (1 << 20), (unsigned long)buf.Capacity() / 1024, errors);
+}
+
+static void Client(int seconds, std::atomic<long>* sent)
+{
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(kPort);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0)
+    {
+        fprintf(stderr, "connect failed: %s\n", strerror(errno));
+        close(fd);
+        return;
+    }
+
+    size_t offset = 0;
+    Clock::time_point deadline = Clock::now() + std::chrono::seconds(seconds);
+    while (Clock::now() < deadline)
+    {
+        ssize_t n = write(fd, g_Source.data() + offset % kPattern, kChunkSize);
+        if (n <= 0)
+        {
+            break;
+        }
+        offset += n;
+    }
+    *sent += offset;
+    close(fd);
+}
+
+static void RunStream(Buffer::Backend backend, size_t backlog, int conns, int seconds)
+{
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort), "MirrorBufferBench");
+    server.SetThreadNum(1);
+    server.SetBufferBackend(backend);
+
+    // 只有一个subloop, 回调都在同一个线程中执行
+    std::unordered_map<TcpConnection*, size_t> offsets;
+    std::atomic<long> consumed(0);
+    std::atomic<long> errors(0);
+    size_t max_capacity = 0;
+    server.SetConnectionCallback([&offsets](const TcpConnectionPtr& conn) {
+        if (!conn->Connected())
+        {
+            offsets.erase(conn.get());
+        }
+    });
+    server.SetMessageCallback([&](const TcpConnectionPtr& conn, Buffer* buf, TimeStamp) {
+        size_t& offset = offsets[conn.get()];
+        size_t before = offset;
+        errors += Consume(buf, backlog, &offset);
+        consumed += offset - before;
+        max_capacity = std::max(max_capacity, buf->Capacity());
+    });
+    server.Start();
+
+    std::atomic<long> sent(0);
+    std::thread driver([&]() {
+        usleep(100 * 1000);
+        std::vector<std::thread> clients;
+        for (int i = 0; i < conns; i++)
+        {
+            clients.emplace_back(Client, seconds, &sent);
+        }
+        for (std::thread& t : clients)
+        {
+            t.join();
+        }
+        usleep(100 * 1000);
+        loop.Quit();
+    });
+
+    loop.Loop();
+    driver.join();
+    fprintf(stderr, "%-6s backlog=%luKB connections=%d sent=%ldMB consumed=%ldMB rate=%.0fMB/s "
+            "max_capacity=%luKB errors=%ld\n",
+            BackendName(backend), (unsigned long)backlog / 1024, conns, sent.load() >> 20, consumed.load() >> 20,
+            static_cast<double>(consumed.load()) / seconds / (1 << 20), (unsigned long)max_capacity / 1024,
+            errors.load());
+}
+
+int main(int argc, char* argv[])
+{
+    std::string mode = argc > 1 ? argv[1] : "buffer";
+    signal(SIGPIPE, SIG_IGN);
+    InitSource();
+
+    if (mode == "buffer")
+    {
+        size_t backlog = (argc > 2 ? atoi(argv[2]) : 256) * 1024;
+        size_t total = static_cast<size_t>(argc > 3 ? atoi(argv[3]) : 4096) << 20;
+        RunBuffer(Buffer::kVectorBackend, backlog, total);
+        RunBuffer(Buffer::kMirrorBackend, backlog, total);
+    }
+    else
+    {
+        Buffer::Backend backend = (argc > 2 && std::string(argv[2]) == "vector") ? Buffer::kVectorBackend
+                                                                                 : Buffer::kMirrorBackend;
+        size_t backlog = (argc > 3 ? atoi(argv[3]) : 256) * 1024;
+        int conns = argc > 4 ? atoi(argv[4]) : 4;
+        int seconds = argc > 5 ? atoi(argv[5]) : 3;
+        RunStream(backend, backlog, conns, seconds);
+    }
+    return 0;
+}
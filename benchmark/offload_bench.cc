@@ -0,0 +1,213 @@
+/*
+CPU密集的请求在IO线程内处理与Offload到计算线程池的对比
+用法: ./offload_bench [inline|offload|strand] [计算线程数] [每个请求的计算时间us] [客户端数] [秒数]
+服务器只有一个subloop, 'w'开头的请求需要计算, 计算时间在[0, 2*计算时间]之间随机, 'p'开头的请求直接回复
+offload: EventLoop::Offload, 同一连接的回复可能乱序; strand: TcpConnection::Offload, 回复保持请求顺序
+计算客户端做流水线请求并检查回复顺序, 另有一个ping客户端统计往返延迟, 反映IO线程是否被计算阻塞
+服务器的日志较多, 运行时建议把stdout重定向到/dev/null, 结果输出到stderr
+*/
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/ComputePool.h>
+#include <mymuduo/Logger.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <signal.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <netinet/tcp.h>
+
+using Clock = std::chrono::steady_clock;
+
+static const uint16_t kPort = 9535;
+static const size_t kMsgSize = 16;
+static const int kDepth = 8;
+
+static void Spin(int us)
+{
+    Clock::time_point end = Clock::now() + std::chrono::microseconds(us);
+    while (Clock::now() < end) {}
+}
+
+static int Connect()
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(kPort);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    if (connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0)
+    {
+        perror("connect");
+        exit(1);
+    }
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    return fd;
+}
+
+// 请求的第2个字节开始是序号, 返回乱序的回复个数, 出错时返回-1
+static int RoundTrip(int fd, char type, int count, uint32_t* seq)
+{
+    char msg[kMsgSize * kDepth];
+    memset(msg, type, sizeof(msg));
+    for (int i = 0; i < count; i++)
+    {
+        uint32_t n = *seq + i;
+        memcpy(msg + i * kMsgSize + 1, &n, sizeof(n));
+    }
+    size_t len = kMsgSize * count;
+    if (write(fd, msg, len) != static_cast<ssize_t>(len))
+    {
+        return false;
+    }
+    size_t got = 0;
+    while (got < len)
+    {
+        ssize_t n = read(fd, msg + got, len - got);
+        if (n <= 0)
+        {
+            return -1;
+        }
+        got += n;
+    }
+    int reordered = 0;
+    for (int i = 0; i < count; i++)
+    {
+        uint32_t n;
+        memcpy(&n, msg + i * kMsgSize + 1, sizeof(n));
+        reordered += n != *seq + i;
+    }
+    *seq += count;
+    return reordered;
+}
+
+static void WorkClient(Clock::time_point deadline, std::atomic<long>* total, std::atomic<long>* reordered)
+{
+    int fd = Connect();
+    long done = 0;
+    uint32_t seq = 0;
+    while (Clock::now() < deadline)
+    {
+        int n = RoundTrip(fd, 'w', kDepth, &seq);
+        if (n < 0)
+        {
+            break;
+        }
+        done += kDepth;
+        *reordered += n;
+    }
+    close(fd);
+    *total += done;
+}
+
+static void PingClient(Clock::time_point deadline, std::vector<double>* latencies)
+{
+    int fd = Connect();
+    uint32_t seq = 0;
+    while (Clock::now() < deadline)
+    {
+        Clock::time_point start = Clock::now();
+        if (RoundTrip(fd, 'p', 1, &seq) < 0)
+        {
+            break;
+        }
+        latencies->push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+        usleep(1000);
+    }
+    close(fd);
+}
+
+int main(int argc, char* argv[])
+{
+    std::string mode = argc > 1 ? argv[1] : "inline";
+    int workers = argc > 2 ? atoi(argv[2]) : 2;
+    int work_us = argc > 3 ? atoi(argv[3]) : 50;
+    int clients = argc > 4 ? atoi(argv[4]) : 4;
+    int seconds = argc > 5 ? atoi(argv[5]) : 3;
+
+    signal(SIGPIPE, SIG_IGN);
+
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort), "OffloadBench");
+    server.SetThreadNum(1);
+    // 先于server析构, 剩余任务的continuation投递时subloop还在运行
+    ComputePool pool(workers);
+    EventLoop* io_loop = nullptr;
+    server.SetThreadInitCallback([&](EventLoop* l) {
+        l->SetComputePool(&pool);
+        io_loop = l;
+    });
+    server.SetConnectionCallback([](const TcpConnectionPtr& conn) {
+        if (conn->Connected())
+        {
+            conn->SetTcpNoDelay(true);
+        }
+    });
+    server.SetMessageCallback([=](const TcpConnectionPtr& conn, Buffer* buf, TimeStamp) {
+        while (buf->ReadableBytes() >= kMsgSize)
+        {
+            std::string msg(buf->Peek(), kMsgSize);
+            buf->Retrieve(kMsgSize);
+            if (msg[0] != 'w')
+            {
+                conn->Send(msg);
+            }
+            int us = work_us > 0 ? rand() % (2 * work_us + 1) : 0;
+            if (mode == "offload")
+            {
+                conn->GetLoop()->Offload([us]() { Spin(us); }, [conn, msg]() { conn->Send(msg); });
+            }
+            else if (mode == "strand")
+            {
+                conn->Offload([us]() { Spin(us); }, [conn, msg]() { conn->Send(msg); });
+            }
+            else
+            {
+                Spin(us);
+                conn->Send(msg);
+            }
+        }
+    });
+    server.Start();
+
+    std::atomic<long> total(0);
+    std::atomic<long> reordered(0);
+    std::vector<double> latencies;
+    std::thread driver([&]() {
+        usleep(100 * 1000);
+        uint64_t wakeups_before = io_loop->WakeupWrites();
+        Clock::time_point deadline = Clock::now() + std::chrono::seconds(seconds);
+        std::vector<std::thread> threads;
+        for (int i = 0; i < clients; i++)
+        {
+            threads.emplace_back(WorkClient, deadline, &total, &reordered);
+        }
+        threads.emplace_back(PingClient, deadline, &latencies);
+        for (std::thread& t : threads)
+        {
+            t.join();
+        }
+        uint64_t wakeups = io_loop->WakeupWrites() - wakeups_before;
+        std::sort(latencies.begin(), latencies.end());
+        size_t n = latencies.size();
+        fprintf(stderr, "mode=%s workers=%d work=%dus requests=%.0f/s reordered=%ld ping p50=%.0fus p99=%.0fus "
+                "tasks=%lu completion_batches=%lu io_wakeups=%lu\n",
+                mode.c_str(), workers, work_us, static_cast<double>(total.load()) / seconds, reordered.load(),
+                n > 0 ? latencies[n / 2] : 0.0, n > 0 ? latencies[n * 99 / 100] : 0.0,
+                (unsigned long)pool.TasksExecuted(), (unsigned long)pool.CompletionBatches(), (unsigned long)wakeups);
+        loop.Quit();
+    });
+
+    loop.Loop();
+    driver.join();
+    return 0;
+}
@@ -0,0 +1,159 @@
+/*
+跨线程投递回调的开销: 无锁MPSC队列 vs 原来的mutex+vector
+用法: ./pending_queue_bench [生产者线程数] [每个线程投递次数]
+*/
+#include <mymuduo/EventLoop.h>
+#include <mymuduo/EventLoopThread.h>
+#include <mymuduo/MpscQueue.h>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <stdio.h>
+#include <stdlib.h>
+
+using Functor = std::function<void()>;
+using Clock = std::chrono::steady_clock;
+
+// 改造前EventLoop中的实现
+class MutexQueue
+{
+public:
+    void Push(Functor cb)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        pending_.emplace_back(std::move(cb));
+    }
+
+    template <typename Func>
+    size_t ConsumeAll(Func&& func)
+    {
+        std::vector<Functor> functors;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            functors.swap(pending_);
+        }
+        for (const Functor& functor : functors)
+        {
+            func(functor);
+        }
+        return functors.size();
+    }
+
+private:
+    std::mutex mutex_;
+    std::vector<Functor> pending_;
+};
+
+// 消费者线程忙等消费, 只比较队列本身的吞吐
+template <typename Queue>
+static double QueueThroughput(int producers, long per_producer)
+{
+    Queue queue;
+    std::atomic<long> done(0);
+    const long total = producers * per_producer;
+
+    auto start = Clock::now();
+    std::thread consumer([&]() {
+        long consumed = 0;
+        while (consumed < total)
+        {
+            consumed += queue.ConsumeAll([](const Functor& f) { f(); });
+        }
+    });
+    std::vector<std::thread> threads;
+    for (int i = 0; i < producers; i++)
+    {
+        threads.emplace_back([&]() {
+            for (long j = 0; j < per_producer; j++)
+            {
+                queue.Push([&done]() { done.fetch_add(1, std::memory_order_relaxed); });
+            }
+        });
+    }
+    for (std::thread& t : threads)
+    {
+        t.join();
+    }
+    consumer.join();
+
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return total / seconds / 1e6;
+}
+
+// 通过EventLoop::QueneInLoop投递, 包含eventfd唤醒的开销
+static void LoopThroughput(EventLoop* loop, int producers, long per_producer)
+{
+    std::atomic<long> done(0);
+    const long total = producers * per_producer;
+
+    auto start = Clock::now();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < producers; i++)
+    {
+        threads.emplace_back([&]() {
+            for (long j = 0; j < per_producer; j++)
+            {
+                loop->QueneInLoop([&done]() { done.fetch_add(1, std::memory_order_relaxed); });
+            }
+        });
+    }
+    for (std::thread& t : threads)
+    {
+        t.join();
+    }
+    while (done.load() < total)
+    {
+        std::this_thread::yield();
+    }
+
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    printf("EventLoop::QueneInLoop: %.2f M posts/s\n", total / seconds / 1e6);
+    printf("eventfd writes: %lu, coalesced wakeups (write syscalls saved): %lu\n",
+           loop->WakeupWrites(), loop->WakeupsCoalesced());
+}
+
+// 投递一个回调, 测量从投递到loop线程开始执行的时间
+static void WakeToRunLatency(EventLoop* loop, int samples)
+{
+    std::vector<double> latencies;
+    latencies.reserve(samples);
+    for (int i = 0; i < samples; i++)
+    {
+        std::atomic<bool> ran(false);
+        Clock::time_point posted = Clock::now();
+        Clock::time_point started;
+        loop->QueneInLoop([&]() {
+            started = Clock::now();
+            ran.store(true, std::memory_order_release);
+        });
+        while (!ran.load(std::memory_order_acquire))
+        {
+            std::this_thread::yield();
+        }
+        latencies.push_back(std::chrono::duration<double, std::micro>(started - posted).count());
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    printf("wake-to-run latency: p50 %.1f us, p99 %.1f us\n",
+           latencies[samples / 2], latencies[samples * 99 / 100]);
+}
+
+int main(int argc, char* argv[])
+{
+    int producers = argc > 1 ? atoi(argv[1]) : 4;
+    long per_producer = argc > 2 ? atol(argv[2]) : 500000;
+
+    printf("mutex+vector queue: %.2f M posts/s\n", QueueThroughput<MutexQueue>(producers, per_producer));
+    printf("mpsc queue:         %.2f M posts/s\n", QueueThroughput<MpscQueue<Functor>>(producers, per_producer));
+
+    EventLoopThread thread;
+    EventLoop* loop = thread.StartLoop();
+    LoopThroughput(loop, producers, per_producer);
+    WakeToRunLatency(loop, 10000);
+
+    return 0;
+}
@@ -0,0 +1,100 @@
+/*
+epoll与io_uring两种Poller后端的echo吞吐对比
+用法: ./poller_bench [epoll|iouring] [连接数] [秒数]
+单个IO线程的echo服务器, 每个客户端线程在一条连接上做64字节的ping-pong
+*/
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/Logger.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+static const uint16_t kPort = 9530;
+static const size_t kMsgSize = 64;
+
+static void Client(int seconds, std::atomic<long>* total)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(kPort);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    if (connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0)
+    {
+        perror("connect");
+        exit(1);
+    }
+
+    char msg[kMsgSize];
+    memset(msg, 'x', sizeof(msg));
+    long count = 0;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+    while (std::chrono::steady_clock::now() < deadline)
+    {
+        if (write(fd, msg, sizeof(msg)) != sizeof(msg))
+        {
+            break;
+        }
+        size_t got = 0;
+        while (got < sizeof(msg))
+        {
+            ssize_t n = read(fd, msg + got, sizeof(msg) - got);
+            if (n <= 0)
+            {
+                close(fd);
+                *total += count;
+                return;
+            }
+            got += n;
+        }
+        ++count;
+    }
+    close(fd);
+    *total += count;
+}
+
+int main(int argc, char* argv[])
+{
+    std::string name = argc > 1 ? argv[1] : "epoll";
+    int conns = argc > 2 ? atoi(argv[2]) : 8;
+    int seconds = argc > 3 ? atoi(argv[3]) : 5;
+    Poller::Backend backend = name == "iouring" ? Poller::kIoUringBackend : Poller::kEpollBackend;
+
+    EventLoop loop(backend);
+    TcpServer server(&loop, InetAddress(kPort), "PollerBench");
+    server.SetConnectionCallback([](const TcpConnectionPtr&) {});
+    server.SetMessageCallback([](const TcpConnectionPtr& conn, Buffer* buf, TimeStamp) {
+        conn->Send(buf->RetrieveAllAsString());
+    });
+    server.Start();
+
+    std::atomic<long> total(0);
+    std::thread driver([&]() {
+        usleep(100 * 1000);
+        std::vector<std::thread> clients;
+        for (int i = 0; i < conns; i++)
+        {
+            clients.emplace_back(Client, seconds, &total);
+        }
+        for (std::thread& t : clients)
+        {
+            t.join();
+        }
+        loop.Quit();
+    });
+
+    loop.Loop();
+    driver.join();
+
+    printf("backend=%s conns=%d seconds=%d round-trips=%ld rate=%.0f/s\n",
+           name.c_str(), conns, seconds, total.load(), (double)total.load() / seconds);
+    return 0;
+}
@@ -0,0 +1,153 @@
+/*
+loop之间转发消息: QueneInLoop(每条消息一个std::function) vs RingChannelMesh
+用法: ./ring_channel_bench [function|ring] [subloop数] [每个loop发送的消息数] [通道容量]
+每个subloop把消息发给下一个subloop(环形), 消费者检查每个生产者的消息顺序
+ring模式下发送方遇到队列满就停下, 等WritableCallback再继续(背压); function模式每轮发送一个容量的消息
+*/
+#include <mymuduo/EventLoop.h>
+#include <mymuduo/EventLoopThreadPool.h>
+#include <mymuduo/RingChannel.h>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <functional>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+using Clock = std::chrono::steady_clock;
+
+struct Message
+{
+    int from;
+    uint64_t seq;
+    char payload[48];
+};
+
+struct Peer
+{
+    EventLoop* loop;
+    EventLoop* next;
+    uint64_t sent;
+    std::vector<uint64_t> expected; // 下一条来自各个生产者的序号
+};
+
+static std::string g_Mode;
+static uint64_t g_Count;
+static size_t g_Capacity;
+static std::vector<Peer> g_Peers;
+static std::atomic<uint64_t> g_Received(0);
+static std::atomic<uint64_t> g_Reordered(0);
+static std::atomic<uint64_t> g_Blocked(0);
+static RingChannelMesh<Message>* g_Mesh = nullptr;
+
+static void Receive(int to, const Message& message)
+{
+    Peer& peer = g_Peers[to];
+    if (message.seq != peer.expected[message.from])
+    {
+        ++g_Reordered;
+    }
+    peer.expected[message.from] = message.seq + 1;
+    ++g_Received;
+}
+
+static void Pump(int index)
+{
+    Peer& peer = g_Peers[index];
+    Message message;
+    memset(&message, 0, sizeof(message));
+    message.from = index;
+    int to = (index + 1) % static_cast<int>(g_Peers.size());
+
+    if (g_Mode == "ring")
+    {
+        while (peer.sent < g_Count)
+        {
+            message.seq = peer.sent;
+            if (!g_Mesh->TrySend(peer.next, message))
+            {
+                ++g_Blocked;
+                return; // 等待WritableCallback
+            }
+            ++peer.sent;
+        }
+    }
+    else
+    {
+        for (size_t i = 0; i < g_Capacity && peer.sent < g_Count; i++)
+        {
+            message.seq = peer.sent++;
+            peer.next->QueneInLoop(std::bind(&Receive, to, message));
+        }
+        if (peer.sent < g_Count)
+        {
+            peer.loop->QueneInLoop(std::bind(&Pump, index));
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    g_Mode = argc > 1 ? argv[1] : "ring";
+    int threads = argc > 2 ? atoi(argv[2]) : 4;
+    g_Count = argc > 3 ? atoll(argv[3]) : 1000000;
+    g_Capacity = argc > 4 ? atoi(argv[4]) : 1024;
+
+    EventLoop base;
+    EventLoopThreadPool pool(&base, "RingBench");
+    pool.SetThreadNum(threads);
+    pool.Start();
+    std::vector<EventLoop*> loops = pool.GetAllLoops();
+    for (int i = 0; i < threads; i++)
+    {
+        g_Peers.push_back(Peer{loops[i], loops[(i + 1) % threads], 0, std::vector<uint64_t>(threads, 0)});
+    }
+
+    RingChannelMesh<Message> mesh(loops, g_Capacity, [&loops](EventLoop* loop, Message& message) {
+        int to = static_cast<int>(std::find(loops.begin(), loops.end(), loop) - loops.begin());
+        Receive(to, message);
+    });
+    g_Mesh = &mesh;
+    for (int i = 0; i < threads; i++)
+    {
+        mesh.Get(loops[i], loops[(i + 1) % threads])->SetWritableCallback(std::bind(&Pump, i));
+    }
+
+    uint64_t wakeups_before = 0;
+    for (EventLoop* loop : loops)
+    {
+        wakeups_before += loop->WakeupWrites();
+    }
+    std::thread driver([&]() {
+        Clock::time_point start = Clock::now();
+        for (int i = 0; i < threads; i++)
+        {
+            loops[i]->QueneInLoop(std::bind(&Pump, i));
+        }
+        uint64_t total = g_Count * threads;
+        while (g_Received.load() < total)
+        {
+            usleep(1000);
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        uint64_t wakeups = 0;
+        for (EventLoop* loop : loops)
+        {
+            wakeups += loop->WakeupWrites();
+        }
+        fprintf(stderr, "mode=%s loops=%d messages=%lu rate=%.2fM/s reordered=%lu blocked=%lu wakeups=%lu\n",
+                g_Mode.c_str(), threads, (unsigned long)total, total / seconds / 1e6,
+                (unsigned long)g_Reordered.load(), (unsigned long)g_Blocked.load(),
+                (unsigned long)(wakeups - wakeups_before));
+        base.Quit();
+    });
+
+    base.Loop();
+    driver.join();
+    return 0;
+}
@@ -0,0 +1,206 @@
+/*
+连接内存的分配开销: SlabPool vs 全局malloc
+用法: ./slab_pool_bench alloc [连接数(万)]
+      ./slab_pool_bench churn [pool|malloc] [客户端线程数] [秒数]
+alloc: 模拟TcpServer的连接生命周期, BaseLoop分配连接对象/Channel/Socket/两个Buffer, 交给subloop释放(跨线程释放)
+       分别用SlabPool::Allocate/Free和operator new/delete执行, 统计每个连接的耗时
+churn: 真实的短连接压力(同conn_rate_bench), malloc模式把所有loop的内存池保留上限设为0, 输出内存池的命中率
+服务器的日志较多, 运行时建议把stdout重定向到/dev/null, 结果输出到stderr
+*/
+#include <mymuduo/TcpServer.h>
+#include <mymuduo/TcpConnection.h>
+#include <mymuduo/EventLoopThread.h>
+#include <mymuduo/Channel.h>
+#include <mymuduo/Socket.h>
+#include <mymuduo/SlabPool.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <signal.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+using Clock = std::chrono::steady_clock;
+
+static const uint16_t kPort = 9539;
+
+// 一个连接在建立时分配的内存: shared_ptr控制块+TcpConnection, Channel, Socket, 输入和输出Buffer
+static const size_t kConnectionBlocks[] = {
+    sizeof(TcpConnection) + 32, sizeof(Channel), sizeof(Socket),
+    Buffer::kCheapPrepend + Buffer::kInitialSize, Buffer::kCheapPrepend + Buffer::kInitialSize,
+};
+static const int kBlocksPerConnection = sizeof(kConnectionBlocks) / sizeof(kConnectionBlocks[0]);
+static const int kBatch = 256; // 每批交给subloop释放的连接数
+
+static void PrintStats(const char* name, EventLoop* loop)
+{
+    SlabPool::Stats stats = loop->GetSlabPool()->GetStats();
+    fprintf(stderr, "  %-8s allocations=%lu hit=%.1f%% remotefrees=%lu inuse=%lu retained=%.1fKB\n", name,
+            (unsigned long)stats.allocations,
+            stats.allocations > 0 ? 100.0 * stats.hits / stats.allocations : 0.0,
+            (unsigned long)stats.remotefrees, (unsigned long)stats.inuseblocks,
+            static_cast<double>(stats.retainedbytes) / 1024);
+}
+
+static void RunAlloc(bool pool, long connections, EventLoop* base, EventLoop* io)
+{
+    std::atomic<int> outstanding(0);
+    Clock::time_point start = Clock::now();
+    for (long done = 0; done < connections; done += kBatch)
+    {
+        std::shared_ptr<std::vector<void*>> blocks = std::make_shared<std::vector<void*>>();
+        blocks->reserve(kBatch * kBlocksPerConnection);
+        for (int i = 0; i < kBatch; i++)
+        {
+            for (int j = 0; j < kBlocksPerConnection; j++)
+            {
+                void* block = pool ? SlabPool::Allocate(kConnectionBlocks[j]) : ::operator new(kConnectionBlocks[j]);
+                memset(block, 0, std::min<size_t>(kConnectionBlocks[j], 64)); // 构造函数只写对象的开头
+                blocks->push_back(block);
+            }
+        }
+        ++outstanding;
+        io->RunInLoop([pool, blocks, &outstanding]() {
+            for (void* block : *blocks)
+            {
+                if (pool)
+                {
+                    SlabPool::Free(block);
+                }
+                else
+                {
+                    ::operator delete(block);
+                }
+            }
+            --outstanding;
+        });
+        while (outstanding.load() > 4)
+        {
+            std::this_thread::yield();
+        }
+    }
+    while (outstanding.load() > 0)
+    {
+        std::this_thread::yield();
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    fprintf(stderr, "%-6s connections=%ld time=%.1fms per_connection=%.0fns\n", pool ? "pool" : "malloc",
+            connections, seconds * 1000, seconds * 1e9 / connections);
+    if (pool)
+    {
+        PrintStats("baseloop", base);
+    }
+}
+
+static void Client(int seconds, std::atomic<long>* total)
+{
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(kPort);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+
+    linger lg;
+    lg.l_onoff = 1;
+    lg.l_linger = 0;
+
+    long conns = 0;
+    Clock::time_point deadline = Clock::now() + std::chrono::seconds(seconds);
+    while (Clock::now() < deadline)
+    {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0)
+        {
+            close(fd);
+            continue;
+        }
+        char c;
+        if (read(fd, &c, 1) == 1)
+        {
+            ++conns;
+        }
+        setsockopt(fd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+        close(fd);
+    }
+    *total += conns;
+}
+
+static void RunChurn(bool pool, int clients, int seconds)
+{
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(kPort), "SlabPoolBench");
+    server.SetThreadNum(1);
+    server.SetThreadInitCallback([pool](EventLoop* io_loop) {
+        if (!pool)
+        {
+            io_loop->GetSlabPool()->SetMaxRetainedBytes(0);
+        }
+    });
+    if (!pool)
+    {
+        loop.GetSlabPool()->SetMaxRetainedBytes(0);
+    }
+    server.SetConnectionCallback([](const TcpConnectionPtr& conn) {
+        if (conn->Connected())
+        {
+            conn->Send("x");
+        }
+    });
+    server.SetMessageCallback([](const TcpConnectionPtr&, Buffer* buf, TimeStamp) { buf->RetrieveAll(); });
+    server.Start();
+
+    std::atomic<long> total(0);
+    std::thread driver([&]() {
+        usleep(100 * 1000);
+        std::vector<std::thread> workers;
+        for (int i = 0; i < clients; i++)
+        {
+            workers.emplace_back(Client, seconds, &total);
+        }
+        for (std::thread& t : workers)
+        {
+            t.join();
+        }
+        usleep(100 * 1000); // 等待最后的连接销毁
+        loop.Quit();
+    });
+
+    loop.Loop();
+    driver.join();
+
+    fprintf(stderr, "%-6s clients=%d connections=%ld rate=%.0f/s\n", pool ? "pool" : "malloc", clients,
+            total.load(), static_cast<double>(total.load()) / seconds);
+    PrintStats("baseloop", &loop);
+    server.RunInAllLoopsAndWait([]() { PrintStats("subloop", EventLoop::LoopOfCurrentThread()); });
+}
+
+int main(int argc, char* argv[])
+{
+    std::string mode = argc > 1 ? argv[1] : "alloc";
+    signal(SIGPIPE, SIG_IGN);
+
+    if (mode == "alloc")
+    {
+        long connections = (argc > 2 ? atol(argv[2]) : 100) * 10000;
+        EventLoop loop; // 当前线程作为BaseLoop, 有自己的内存池
+        EventLoopThread io_thread(EventLoopThread::ThreadInitCallback(), "BenchIo");
+        EventLoop* io_loop = io_thread.StartLoop();
+        RunAlloc(false, connections, &loop, io_loop);
+        RunAlloc(true, connections, &loop, io_loop);
+    }
+    else
+    {
+        bool pool = !(argc > 2 && std::string(argv[2]) == "malloc");
+        int clients = argc > 3 ? atoi(argv[3]) : 4;
+        int seconds = argc > 4 ? atoi(argv[4]) : 3;
+        RunChurn(pool, clients, seconds);
+    }
+    return 0;
+}
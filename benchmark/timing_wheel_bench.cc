@@ -0,0 +1,67 @@
+/*
+时间轮的Touch/Advance开销
+用法: ./timing_wheel_bench [条目数] [Touch次数]
+*/
+#include <mymuduo/EventLoop.h>
+#include <mymuduo/TimingWheel.h>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+
+static double ElapsedNs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char* argv[])
+{
+    size_t entries = argc > 1 ? atol(argv[1]) : 1000000;
+    size_t touches = argc > 2 ? atol(argv[2]) : 10000000;
+
+    EventLoop loop;
+    TimingWheel wheel(&loop, 1.0);
+    std::vector<TimingWheel::Entry> conns(entries);
+    long expired = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < entries; i++)
+    {
+        // 超时分布在第0级和第1级
+        wheel.Add(&conns[i], 30 + i % 600, [&expired]() { ++expired; });
+    }
+    printf("add:     %8.1f ns/op (%lu entries)\n", ElapsedNs(start) / entries, entries);
+
+    std::vector<uint32_t> order(touches);
+    std::mt19937 rng(42);
+    for (size_t i = 0; i < touches; i++)
+    {
+        order[i] = rng() % entries;
+    }
+
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < touches; i++)
+    {
+        wheel.Touch(&conns[i % entries]);
+    }
+    printf("touch sequential: %8.2f ns/op\n", ElapsedNs(start) / touches);
+
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < touches; i++)
+    {
+        wheel.Touch(&conns[order[i]]);
+    }
+    printf("touch random:     %8.2f ns/op\n", ElapsedNs(start) / touches);
+
+    // 转动到所有条目都过期, 统计每格的平均开销
+    const int ticks = 1024;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ticks; i++)
+    {
+        wheel.Advance();
+    }
+    printf("advance: %8.1f us/tick, expired %ld, remaining %lu\n", ElapsedNs(start) / ticks / 1000, expired, wheel.Size());
+
+    return 0;
+}
@@ -2,6 +2,7 @@
 #include <sys/types.h>
 #include <errno.h>
 #include <unistd.h>
+#include <fcntl.h>
 
 #include "Acceptor.h"
 #include "Logger.h"
@@ -13,17 +14,23 @@ static int CreateNonblocking()
     if (sockfd < 0)
     {
         LOG_FATAL("listen socket create error: %d\n", errno);
-    }   
+    }
+    return sockfd;
 }
 
+// 连接风暴时一次可读事件尽量多accept, 又不至于让其他Channel等待太久
+static const int kDefaultAcceptBatch = 64;
+
 Acceptor::Acceptor(EventLoop* loop, const InetAddress& listen_addr, bool reuseport)
     : loop_(loop)
     , AcceptSocket_(CreateNonblocking())
     , AcceptChannel_(loop, AcceptSocket_.Fd())
+    , AcceptBatch_(kDefaultAcceptBatch)
     , listenning_(false)
+    , IdleFd_(open("/dev/null", O_RDONLY | O_CLOEXEC))
 {
     AcceptSocket_.SetReuseAddr(true);
-    AcceptSocket_.SetReusePort(true);
+    AcceptSocket_.SetReusePort(reuseport);
     AcceptSocket_.BindAddress(listen_addr);
     // 有新用户的连接, 要执行一个回调 (connfd ==> channel ==> subloop)
     AcceptChannel_.SetReadCallback(std::bind(&Acceptor::HandleRead, this));
@@ -33,6 +40,7 @@ Acceptor::~Acceptor()
 {
     AcceptChannel_.DisableAll();
     AcceptChannel_.Remove();
+    close(IdleFd_);
 }
 
 void Acceptor::Listen()
@@ -42,13 +50,51 @@ void Acceptor::Listen()
     AcceptChannel_.EnableReading(); //  AcceptChannel_ ==> Poller
 }
 
-// listenfd有事件发生, 就是有新用户连接
+void Acceptor::StopAccepting()
+{
+    if (AcceptChannel_.IsReading())
+    {
+        AcceptChannel_.DisableReading();
+    }
+}
+
+void Acceptor::StartAccepting()
+{
+    if (listenning_ && !AcceptChannel_.IsReading())
+    {
+        AcceptChannel_.EnableReading();
+    }
+}
+
+// listenfd有事件发生, 就是有新用户连接, 一次最多accept AcceptBatch_个, 直到全连接队列为空
 void Acceptor::HandleRead()
 {
-    InetAddress peer_addr;
-    int connfd = AcceptSocket_.Accept(&peer_addr);
-    if (connfd >= 0)
+    int accepted = 0;
+    // 回调中可能因为连接数达到上限而StopAccepting
+    while (accepted < AcceptBatch_ && AcceptChannel_.IsReading())
     {
+        InetAddress peer_addr;
+        int connfd = AcceptSocket_.Accept(&peer_addr);
+        if (connfd < 0)
+        {
+            int saved_errno = errno;
+            if (saved_errno != EAGAIN && saved_errno != EWOULDBLOCK)
+            {
+                LOG_ERROR("accept error: %d\n", saved_errno);
+                if (saved_errno == EMFILE || saved_errno == ENFILE)
+                {
+                    LOG_ERROR("sockfd reached limit!\n");
+                    // 让出预留的fd, 把这个连接accept之后马上关闭, 否则监听socket一直可读, loop会空转
+                    close(IdleFd_);
+                    IdleFd_ = accept(AcceptSocket_.Fd(), nullptr, nullptr);
+                    close(IdleFd_);
+                    IdleFd_ = open("/dev/null", O_RDONLY | O_CLOEXEC);
+                }
+            }
+            break;
+        }
+
+        ++accepted;
         if (newconnectioncallback_)
         {
             newconnectioncallback_(connfd, peer_addr); // 轮询找到subloop, 唤醒, 分发当前的新客户端的Channel
@@ -58,12 +104,9 @@ void Acceptor::HandleRead()
             close(connfd);
         }
     }
-    else
+
+    if (accepted > 0 && AcceptBatchCallback_)
     {
-        LOG_ERROR("accept error: %d\n", errno);
-        if (errno == EMFILE)
-        {
-            LOG_ERROR("sockfd reached limit!\n");
-        }
+        AcceptBatchCallback_();
     }
-}
\ No newline at end of file
+}
@@ -13,6 +13,7 @@ class Acceptor: noncopyable
 {
 public:
     using NewConnectionCallback = std::function<void(int sockfd, const InetAddress&)>;
+    using AcceptBatchCallback = std::function<void()>;
     Acceptor(EventLoop* loop, const InetAddress& listen_addr, bool reuseport);
     ~Acceptor();
 
@@ -20,16 +21,28 @@ public:
     {
         newconnectioncallback_ = std::move(cb);
     }
+    // 一次HandleRead中的所有新连接都交给NewConnectionCallback之后调用, 用来把这一批连接一起分发
+    void SetAcceptBatchCallback(const AcceptBatchCallback& cb) { AcceptBatchCallback_ = cb; }
+    // 每次监听socket可读时最多accept多少个连接
+    void SetAcceptBatch(int batch) { AcceptBatch_ = batch > 0 ? batch : 1; }
 
+    EventLoop* GetLoop() const { return loop_; }
     bool Listenning() const { return listenning_; }
     void Listen();
 
+    // 暂停/恢复监听socket的读事件, 连接数超过上限时由TcpServer调用, 必须在loop_线程中调用
+    void StopAccepting();
+    void StartAccepting();
+
 private:
     void HandleRead();
 
-    EventLoop* loop_; // Acceptor用的就是用户定义的那个BaseLoop, 也叫mainloop
+    EventLoop* loop_; // 默认是用户定义的那个BaseLoop, 也叫mainloop; SO_REUSEPORT模式下是各个subloop
     Socket AcceptSocket_;
     Channel AcceptChannel_;
     NewConnectionCallback newconnectioncallback_;
+    AcceptBatchCallback AcceptBatchCallback_;
+    int AcceptBatch_;
     bool listenning_;
+    int IdleFd_; // 预留的空闲fd, fd耗尽时用它接受并立即关闭一个连接, 避免LT模式下监听socket一直可读
 };
\ No newline at end of file
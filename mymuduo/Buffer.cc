@@ -3,12 +3,23 @@
 #include <unistd.h>
 
 #include "Buffer.h"
+#include "Logger.h"
+
+char* Buffer::EmptyBegin()
+{
+    static char empty[kCheapPrepend];
+    return empty;
+}
 
 // 从fd上读取数据 Poller工作在LT模式
 // Buffer缓冲区是有大小的, 但是从fd上读数据的时候, 却不知道tcp数据最终的大小
 ssize_t Buffer::ReadFd(int fd, int* saved_errno)
 {
     char extrabuf[65536] = {0}; // 栈上的内存空间 64k
+    if (Capacity() == 0)
+    {
+        EnsureWritableBytes(InitialSize_); // 第一次读数据, 先分配初始大小, 小消息直接读进缓冲区
+    }
     iovec vec[2];
     const size_t writable = WritableBytes(); // Buffer底层缓冲区剩余可写空间大小
 
@@ -30,7 +41,7 @@ ssize_t Buffer::ReadFd(int fd, int* saved_errno)
     }
     else // extrabuf里面也写入了数据
     {
-        WriterIndex_ = buffer_.size();
+        WriterIndex_ += writable;
         Append(extrabuf, n - writable); // WriterIndex_开始写(n - writable)大小的数据
     }
 
@@ -46,4 +57,79 @@ ssize_t Buffer::WriteFd(int fd, int* saved_errno)
     }
     
     return n;
-}
\ No newline at end of file
+}
+
+void Buffer::SetBackend(Backend backend)
+{
+    if (ReadableBytes() > 0)
+    {
+        LOG_ERROR("Buffer::SetBackend with %lu readable bytes\n", (unsigned long)ReadableBytes());
+        return;
+    }
+    backend_ = backend;
+    Shrink();
+}
+
+void Buffer::GrowRing(size_t len)
+{
+    size_t readable = ReadableBytes();
+    size_t size = std::max(readable + len, ring_ ? 2 * ring_->Size() : InitialSize_);
+    std::unique_ptr<MirrorRing> ring(MirrorRing::Create(size));
+    if (!ring)
+    {
+        // 无法创建映射(fd或者映射数用完), 退回vector
+        LOG_ERROR("Buffer::GrowRing fall back to vector backend\n");
+        std::vector<char, SlabAllocator<char>> buf(kCheapPrepend + readable + len);
+        std::copy(Peek(), Peek() + readable, buf.begin() + kCheapPrepend);
+        buffer_.swap(buf);
+        ring_.reset();
+        backend_ = kVectorBackend;
+        ReaderIndex_ = kCheapPrepend;
+        WriterIndex_ = kCheapPrepend + readable;
+        return;
+    }
+    std::copy(Peek(), Peek() + readable, ring->Base());
+    ring_.swap(ring);
+    ReaderIndex_ = 0;
+    WriterIndex_ = readable;
+}
+
+void Buffer::Shrink()
+{
+    size_t readable = ReadableBytes();
+    if (readable == 0)
+    {
+        std::vector<char, SlabAllocator<char>>().swap(buffer_);
+        ring_.reset();
+    }
+    else if (ring_)
+    {
+        // 只保留能放下可读数据的最小的环
+        if (MirrorRing::RoundUp(readable) >= ring_->Size())
+        {
+            return;
+        }
+        std::unique_ptr<MirrorRing> ring(MirrorRing::Create(readable));
+        if (!ring)
+        {
+            return;
+        }
+        std::copy(Peek(), Peek() + readable, ring->Base());
+        ring_.swap(ring);
+        ReaderIndex_ = 0;
+        WriterIndex_ = readable;
+        return;
+    }
+    else if (buffer_.capacity() > kCheapPrepend + readable)
+    {
+        std::vector<char, SlabAllocator<char>> buf(kCheapPrepend + readable);
+        std::copy(Peek(), Peek() + readable, buf.begin() + kCheapPrepend);
+        buffer_.swap(buf);
+    }
+    else
+    {
+        return;
+    }
+    ReaderIndex_ = kCheapPrepend;
+    WriterIndex_ = kCheapPrepend + readable;
+}
@@ -3,8 +3,13 @@
 #include <vector>
 #include <stdlib.h>
 #include <string>
+#include <memory>
 #include <algorithm>
 
+#include "noncopyable.h"
+#include "SlabPool.h"
+#include "MirrorRing.h"
+
 /*                         Buffer
 +-------------------+-------------------+-------------------+
 | prependable bytes |  readable bytes   |   writable bytes  |
@@ -12,25 +17,51 @@
 +-------------------+-------------------+-------------------+
 |                   |                   |                   |
 0      <==     ReaderIndex   <==   WriterIndex     <==     size          
-*/
 
+kMirrorBackend: 底层是MirrorRing, 可读数据不需要移动到开头
+0 <= ReaderIndex < ring size, WriterIndex - ReaderIndex <= ring size
+WriterIndex超过ring size的部分落在第二次映射中, Peek()/BeginWrite()总是连续的
+没有prependable空间, 写满时换一个更大的环, 只复制一次可读数据
+*/
 
 // 网络库底层的缓冲区类型定义
-class Buffer
+// 底层内存在第一次写入时才分配, 空闲的连接不占用缓冲区内存
+class Buffer: noncopyable
 {
 public:
     static const size_t kCheapPrepend = 8;
     static const size_t kInitialSize = 1024;
 
-    explicit Buffer(size_t initial_size = kInitialSize)
-        : buffer_(kCheapPrepend + initial_size)
+    // 底层存储
+    enum Backend
+    {
+        kVectorBackend, // vector, 可读数据移动到开头腾出空间
+        kMirrorBackend, // 双重映射的环, 长期半满的流式连接不需要移动数据
+    };
+
+    explicit Buffer(size_t initial_size = kInitialSize, Backend backend = kVectorBackend)
+        : InitialSize_(initial_size)
+        , backend_(backend)
         , ReaderIndex_(kCheapPrepend)
         , WriterIndex_(kCheapPrepend)
     {}
 
+    // 切换底层存储, 只能在没有可读数据时调用, 已经分配的内存被释放
+    void SetBackend(Backend backend);
+    Backend GetBackend() const { return backend_; }
+
     size_t ReadableBytes() const { return WriterIndex_ - ReaderIndex_; }
-    size_t WritableBytes() const { return buffer_.size() - WriterIndex_; }
-    size_t PrependableBytes() const { return ReaderIndex_; }
+    size_t WritableBytes() const
+    {
+        if (ring_)
+        {
+            return ring_->Size() - ReadableBytes();
+        }
+        return buffer_.size() > WriterIndex_ ? buffer_.size() - WriterIndex_ : 0;
+    }
+    size_t PrependableBytes() const { return ring_ ? 0 : ReaderIndex_; }
+    // 底层占用的内存字节数, 还没有分配时为0
+    size_t Capacity() const { return ring_ ? ring_->Size() : buffer_.capacity(); }
 
     // 返回缓冲区中可读数据的起始地址
     const char* Peek() const { return Begin() + ReaderIndex_; }
@@ -41,6 +72,12 @@ public:
         {
             // 应用只读取了可读缓冲区数据的一部分, 还剩下ReaderIndex_ + len ==> WriterIndex_没读
             ReaderIndex_ += len; 
+            if (ring_ && ReaderIndex_ >= ring_->Size())
+            {
+                // 读位置进入第二次映射, 两个位置一起绕回环首
+                ReaderIndex_ -= ring_->Size();
+                WriterIndex_ -= ring_->Size();
+            }
         }
         else // len == ReadableBytes()
         {
@@ -50,8 +87,8 @@ public:
 
     void RetrieveAll()
     {
-        ReaderIndex_ = kCheapPrepend;
-        WriterIndex_ = kCheapPrepend;
+        ReaderIndex_ = ring_ ? 0 : kCheapPrepend;
+        WriterIndex_ = ReaderIndex_;
     }
 
     // 把OnMessage函数上报的Buffer数据, 转化成string类型返回
@@ -92,15 +129,35 @@ public:
     // 通过fd发送数据
     ssize_t WriteFd(int fd, int* saved_errno);
 
+    // 释放多余的内存: 没有可读数据时全部释放, 下次写入时重新分配; 否则只保留可读数据
+    void Shrink();
+
 private:
-    char* Begin() { return &*buffer_.begin(); }
-    const char* Begin() const { return &*buffer_.begin(); }
+    // 还没有分配内存时指向一块静态的空数组, 保证Peek()总是返回有效的地址
+    char* Begin()
+    {
+        if (ring_)
+        {
+            return ring_->Base();
+        }
+        return buffer_.empty() ? EmptyBegin() : &*buffer_.begin();
+    }
+    const char* Begin() const { return const_cast<Buffer*>(this)->Begin(); }
+    static char* EmptyBegin();
+
+    // 换一个能再写入len字节的环, 可读数据复制到新环的开头
+    void GrowRing(size_t len);
 
     void MakeSpace(size_t len)
     {
-        if (WritableBytes() + PrependableBytes() < len + kCheapPrepend)
+        if (backend_ == kMirrorBackend)
+        {
+            GrowRing(len);
+        }
+        else if (WritableBytes() + PrependableBytes() < len + kCheapPrepend)
         {
-            buffer_.resize(WriterIndex_ + len);
+            // 第一次分配时至少分配InitialSize_
+            buffer_.resize(std::max(WriterIndex_ + len, kCheapPrepend + InitialSize_));
         }
         else
         {
@@ -112,7 +169,10 @@ private:
         }
     }
 
-    std::vector<char> buffer_;
+    std::vector<char, SlabAllocator<char>> buffer_; // 不超过16KB时从当前loop的内存池分配
+    std::unique_ptr<MirrorRing> ring_; // kMirrorBackend, 第一次写入时创建
+    size_t InitialSize_;
+    Backend backend_;
     size_t ReaderIndex_;
     size_t WriterIndex_;
 };
\ No newline at end of file
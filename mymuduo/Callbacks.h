@@ -14,4 +14,6 @@ using WriteCompleteCallback = std::function<void(const TcpConnectionPtr&)>;
 
 using MessageCallback = std::function<void(const TcpConnectionPtr&, Buffer*, TimeStamp)>;
 
-using HighWaterMarkCallback = std::function<void(const TcpConnectionPtr&, size_t)>;
\ No newline at end of file
+using HighWaterMarkCallback = std::function<void(const TcpConnectionPtr&, size_t)>;
+
+using TimerCallback = std::function<void()>;
\ No newline at end of file
@@ -0,0 +1,185 @@
+#include <errno.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <algorithm>
+
+#include "ChainBuffer.h"
+
+ChainBuffer::ChainBuffer()
+    : readable_(0)
+{}
+
+ChainBuffer::~ChainBuffer()
+{
+    RetrieveAll();
+}
+
+ChainBuffer::Slab* ChainBuffer::NewSlab()
+{
+    static_assert(sizeof(Slab) == SlabPool::kMaxAllocSize, "slab should fill the largest SlabPool block");
+    Slab* slab = static_cast<Slab*>(SlabPool::Allocate(sizeof(Slab)));
+    slab->ReaderIndex = 0;
+    slab->WriterIndex = 0;
+    return slab;
+}
+
+void ChainBuffer::FreeSlab(Slab* slab)
+{
+    SlabPool::Free(slab);
+}
+
+const char* ChainBuffer::Peek() const
+{
+    if (slabs_.empty())
+    {
+        return nullptr;
+    }
+    const Slab* front = slabs_.front();
+    return front->data + front->ReaderIndex;
+}
+
+size_t ChainBuffer::ContiguousBytes() const
+{
+    if (slabs_.empty())
+    {
+        return 0;
+    }
+    const Slab* front = slabs_.front();
+    return front->WriterIndex - front->ReaderIndex;
+}
+
+void ChainBuffer::PopFront()
+{
+    FreeSlab(slabs_.front());
+    slabs_.pop_front();
+}
+
+void ChainBuffer::Retrieve(size_t len)
+{
+    if (len >= readable_)
+    {
+        RetrieveAll();
+        return;
+    }
+    readable_ -= len;
+    while (len > 0)
+    {
+        Slab* front = slabs_.front();
+        size_t n = std::min(len, front->WriterIndex - front->ReaderIndex);
+        front->ReaderIndex += n;
+        len -= n;
+        // 读完并且写满的slab不会再被使用, 整块释放; 尾部slab还可以继续追加
+        if (front->ReaderIndex == kSlabSize)
+        {
+            PopFront();
+        }
+    }
+}
+
+void ChainBuffer::RetrieveAll()
+{
+    while (!slabs_.empty())
+    {
+        PopFront();
+    }
+    readable_ = 0;
+}
+
+std::string ChainBuffer::RetrieveAsString(size_t len)
+{
+    len = std::min(len, readable_);
+    std::string result;
+    result.reserve(len);
+    size_t left = len;
+    for (size_t i = 0; left > 0; i++)
+    {
+        const Slab* slab = slabs_[i];
+        size_t n = std::min(left, slab->WriterIndex - slab->ReaderIndex);
+        result.append(slab->data + slab->ReaderIndex, n);
+        left -= n;
+    }
+    Retrieve(len);
+    return result;
+}
+
+void ChainBuffer::Append(const char* data, size_t len)
+{
+    readable_ += len;
+    while (len > 0)
+    {
+        if (slabs_.empty() || slabs_.back()->WriterIndex == kSlabSize)
+        {
+            slabs_.push_back(NewSlab());
+        }
+        Slab* back = slabs_.back();
+        size_t n = std::min(len, kSlabSize - back->WriterIndex);
+        memcpy(back->data + back->WriterIndex, data, n);
+        back->WriterIndex += n;
+        data += n;
+        len -= n;
+    }
+}
+
+ssize_t ChainBuffer::ReadFd(int fd, int* saved_errno)
+{
+    // 先接上几个新的slab, 读完之后没有用到的再释放
+    size_t old_slabs = slabs_.size();
+    bool tail_full = slabs_.empty() || slabs_.back()->WriterIndex == kSlabSize;
+    for (int i = 0; i < kReadSlabs; i++)
+    {
+        slabs_.push_back(NewSlab());
+    }
+
+    iovec vec[kReadSlabs + 1];
+    int iovcnt = 0;
+    size_t first = tail_full ? old_slabs : old_slabs - 1;
+    for (size_t i = first; i < slabs_.size(); i++)
+    {
+        Slab* slab = slabs_[i];
+        vec[iovcnt].iov_base = slab->data + slab->WriterIndex;
+        vec[iovcnt].iov_len = kSlabSize - slab->WriterIndex;
+        ++iovcnt;
+    }
+
+    ssize_t n = readv(fd, vec, iovcnt);
+    if (n < 0)
+    {
+        *saved_errno = errno;
+    }
+    size_t left = n > 0 ? n : 0;
+    readable_ += left;
+    for (size_t i = first; i < slabs_.size() && left > 0; i++)
+    {
+        Slab* slab = slabs_[i];
+        size_t filled = std::min(left, kSlabSize - slab->WriterIndex);
+        slab->WriterIndex += filled;
+        left -= filled;
+    }
+    while (slabs_.size() > old_slabs && slabs_.back()->WriterIndex == 0)
+    {
+        FreeSlab(slabs_.back());
+        slabs_.pop_back();
+    }
+    return n;
+}
+
+ssize_t ChainBuffer::WriteFd(int fd, int* saved_errno)
+{
+    iovec vec[kWriteSlabs];
+    int iovcnt = 0;
+    for (size_t i = 0; i < slabs_.size() && iovcnt < kWriteSlabs; i++)
+    {
+        Slab* slab = slabs_[i];
+        vec[iovcnt].iov_base = slab->data + slab->ReaderIndex;
+        vec[iovcnt].iov_len = slab->WriterIndex - slab->ReaderIndex;
+        ++iovcnt;
+    }
+
+    ssize_t n = writev(fd, vec, iovcnt);
+    if (n < 0)
+    {
+        *saved_errno = errno;
+    }
+    return n;
+}
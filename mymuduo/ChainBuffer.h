@@ -0,0 +1,72 @@
+#pragma once
+
+#include <deque>
+#include <string>
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "noncopyable.h"
+#include "SlabPool.h"
+
+/*                         ChainBuffer
+  slab 0                  slab 1                  slab 2
++---------+-------------+ +---------------------+ +-----------+---------+
+| retired |  readable   | |      readable       | | readable  | writable|
++---------+-------------+ +---------------------+ +-----------+---------+
+          ^ Peek()                                            ^ 追加位置
+
+由固定大小的slab串成的缓冲区, 用于大块数据的发送缓冲
+Append只写入尾部slab, 写满了再接一个新的slab, 已有的数据永远不会被移动或复制
+Retrieve整块释放读完的slab, 还给loop的内存池, 缓冲区读空之后不占用内存
+ReadFd/WriteFd用readv/writev直接在slab链上读写
+Peek()只返回第一个slab中的可读数据, 小于一个slab的消息与Buffer的用法相同
+*/
+class ChainBuffer: noncopyable
+{
+public:
+    // 每个slab连同头部正好占用SlabPool最大的块
+    static const size_t kSlabSize = SlabPool::kMaxAllocSize - 2 * sizeof(size_t);
+
+    ChainBuffer();
+    ~ChainBuffer();
+
+    size_t ReadableBytes() const { return readable_; }
+    // 已经分配的slab占用的字节数
+    size_t Capacity() const { return slabs_.size() * kSlabSize; }
+
+    // 第一个slab中可读数据的起始地址和长度, 可读数据不超过一个slab时就是全部数据
+    const char* Peek() const;
+    size_t ContiguousBytes() const;
+
+    void Retrieve(size_t len);
+    void RetrieveAll();
+    std::string RetrieveAsString(size_t len);
+    std::string RetrieveAllAsString() { return RetrieveAsString(ReadableBytes()); }
+
+    void Append(const char* data, size_t len);
+    void Append(const std::string& data) { Append(data.data(), data.size()); }
+
+    // 从fd上读取数据, 最多再接上kReadSlabs个新的slab
+    ssize_t ReadFd(int fd, int* saved_errno);
+    // 通过fd发送数据, 一次writev最多覆盖kWriteSlabs个slab
+    ssize_t WriteFd(int fd, int* saved_errno);
+
+private:
+    struct Slab
+    {
+        size_t ReaderIndex; // 可读数据的起止位置
+        size_t WriterIndex;
+        char data[kSlabSize];
+    };
+
+    static const int kReadSlabs = 4;
+    static const int kWriteSlabs = 64;
+
+    // slab从当前loop的内存池分配
+    static Slab* NewSlab();
+    static void FreeSlab(Slab* slab);
+    void PopFront();
+
+    std::deque<Slab*> slabs_;
+    size_t readable_;
+};
@@ -7,9 +7,11 @@
 const int Channel::kNoneEvent = 0;
 const int Channel::kReadEvent = EPOLLIN | EPOLLPRI;
 const int Channel::kWriteEvent = EPOLLOUT;
+const int Channel::kEdgeEvent = EPOLLET;
 
 Channel::Channel(EventLoop* loop, int fd)
-    : loop_(loop), fd_(fd), events_(0), revents_(0), index_(-1), tied_(false)
+    : loop_(loop), fd_(fd), events_(0), revents_(0), index_(-1), EdgeTriggered_(false)
+    , RegisteredEvents_(0), PendingIndex_(-1), tied_(false)
 {}
 
 Channel::~Channel() {}
@@ -56,7 +58,7 @@ void Channel::HandleEvent(TimeStamp receive_time) // fd得到Poller通知后处
 // 根据Poller通知的Channel发生的具体事件, 由Channel负责调用具体的回调操作
 void Channel::HandleEventWithGuard(TimeStamp receive_time)
 {
-    LOG_INFO("Channel HandleEvent revents: %d\n", revents_);
+    LOG_DEBUG("Channel HandleEvent revents: %d\n", revents_);
 
     if ((revents_ & EPOLLHUP) && !(revents_ & EPOLLIN))
     {
@@ -5,6 +5,7 @@
 
 #include "noncopyable.h"
 #include "Timestamp.h"
+#include "SlabPool.h"
 
 // EventLoop类型的前置声明, 只在.h文件中使用, 具体实现的使用在.cc文件中
 // 由于头文件需要向外部提供, 避免暴露过多头文件
@@ -25,6 +26,10 @@ public:
     Channel(EventLoop* loop, int fd);
     ~Channel();
 
+    // 随连接创建和销毁, 从当前loop的内存池分配
+    static void* operator new(size_t size) { return SlabPool::Allocate(size); }
+    static void operator delete(void* ptr) { SlabPool::Free(ptr); }
+
     // 使用了具体的类型, 无法使用类型前置声明, 需要引入头文件
     void HandleEvent(TimeStamp receive_time); // fd得到Poller通知后处理事件
 
@@ -38,7 +43,8 @@ public:
     void Tie(const std::shared_ptr<void>&);
 
     int Fd() const { return fd_; }
-    int Events() const { return events_; }
+    // 交给Poller注册的事件, ET模式下附带EPOLLET
+    int Events() const { return EdgeTriggered_ ? (events_ | kEdgeEvent) : events_; }
     void SetRevents(int revt) { revents_ = revt; }
 
     // 设置fd相应的事件状态
@@ -48,6 +54,10 @@ public:
     void DisableWriting() { events_ &= ~kWriteEvent; Update(); }
     void DisableAll() { events_ = kNoneEvent; Update(); }
 
+    // 设置fd的触发模式, ET模式下回调需要一直读/写到EAGAIN
+    void SetEdgeTriggered(bool on) { EdgeTriggered_ = on; }
+    bool IsEdgeTriggered() const { return EdgeTriggered_; }
+
     // 返回fd当前的事件状态
     bool IsNoneEvent() const { return events_ == kNoneEvent; }
     bool IsWriting() const { return events_ & kWriteEvent; }
@@ -56,6 +66,12 @@ public:
     int Index() { return index_; }
     void SetIndex(int idx) { index_ = idx; }
 
+    // Poller延迟提交interest变化时使用: 已经注册到内核的事件, 以及在待提交列表中的位置(-1表示不在列表中)
+    int RegisteredEvents() const { return RegisteredEvents_; }
+    void SetRegisteredEvents(int events) { RegisteredEvents_ = events; }
+    int PendingIndex() const { return PendingIndex_; }
+    void SetPendingIndex(int idx) { PendingIndex_ = idx; }
+
     EventLoop* OwnerLoop() { return loop_; }
     void Remove();
     
@@ -67,12 +83,16 @@ private:
     static const int kNoneEvent;
     static const int kReadEvent;
     static const int kWriteEvent;
+    static const int kEdgeEvent;
 
     EventLoop* loop_; // 事件循环
     const int fd_; // fd, Poller监听的对象
     int events_; // 注册fd感兴趣的事件
     int revents_; // Poller返回的具体发生的事件
     int index_;
+    bool EdgeTriggered_; // 是否工作在ET模式
+    int RegisteredEvents_;
+    int PendingIndex_;
 
     std::weak_ptr<void> tie_;
     bool tied_;
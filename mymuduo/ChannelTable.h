@@ -0,0 +1,73 @@
+#pragma once
+
+#include <vector>
+#include <stddef.h>
+
+#include "noncopyable.h"
+
+class Channel;
+
+/*
+以fd为下标的Channel表, fd是小而稠密的整数, 直接用连续数组代替哈希表
+查找/插入/删除都是一次数组访问, 没有哈希和节点分配, 容量不足时按2倍增长
+空槽为nullptr, 容量只增不减, 被关闭的fd很快会被内核复用
+*/
+class ChannelTable: noncopyable
+{
+public:
+    ChannelTable()
+        : count_(0)
+    {}
+
+    Channel* Find(int fd) const
+    {
+        return fd >= 0 && static_cast<size_t>(fd) < slots_.size() ? slots_[fd] : nullptr;
+    }
+
+    void Insert(int fd, Channel* channel)
+    {
+        if (static_cast<size_t>(fd) >= slots_.size())
+        {
+            Grow(fd);
+        }
+        if (slots_[fd] == nullptr)
+        {
+            ++count_;
+        }
+        slots_[fd] = channel;
+    }
+
+    void Erase(int fd)
+    {
+        if (fd >= 0 && static_cast<size_t>(fd) < slots_.size() && slots_[fd] != nullptr)
+        {
+            slots_[fd] = nullptr;
+            --count_;
+        }
+    }
+
+    // 已注册的Channel个数
+    size_t size() const { return count_; }
+    // 当前可以直接容纳的最大fd + 1
+    size_t capacity() const { return slots_.size(); }
+
+private:
+    static const size_t kInitialSize = 64;
+
+    void Grow(int fd)
+    {
+        size_t n = slots_.size();
+        if (n == 0)
+        {
+            n = kInitialSize;
+        }
+        while (n <= static_cast<size_t>(fd))
+        {
+            n *= 2;
+        }
+        slots_.resize(n, nullptr);
+    }
+
+    std::vector<Channel*> slots_;
+    size_t count_;
+};
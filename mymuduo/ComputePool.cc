@@ -0,0 +1,212 @@
+#include <chrono>
+#include <thread>
+#include <stdio.h>
+
+#include "ComputePool.h"
+#include "Thread.h"
+#include "EventLoop.h"
+
+// 当前线程所属的ComputePool和worker下标, worker中提交的任务直接放入自己的队列
+static __thread ComputePool* t_CurrentPool = nullptr;
+static __thread int t_WorkerIndex = -1;
+
+// worker最多攒多少个continuation, 以及攒多久, 之后必须投递出去
+static const size_t kMaxCompletionBatch = 64;
+static const int64_t kMaxCompletionDelayUs = 200;
+
+static int64_t NowUs()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+ComputePool::ComputePool(int num_threads, const std::string& name)
+    : NextWorker_(0)
+    , QueuedJobs_(0)
+    , IdleWorkers_(0)
+    , running_(true)
+    , TasksExecuted_(0)
+    , CompletionBatches_(0)
+{
+    if (num_threads <= 0)
+    {
+        num_threads = 1;
+    }
+    for (int i = 0; i < num_threads; i++)
+    {
+        workers_.emplace_back(new Worker());
+        workers_.back()->FirstCompletionUs = 0;
+    }
+    // 所有worker都创建好之后再启动线程, 偷任务时会访问其他worker
+    for (int i = 0; i < num_threads; i++)
+    {
+        char buf[name.size() + 32];
+        snprintf(buf, sizeof(buf), "%s%d", name.c_str(), i);
+        threads_.emplace_back(new Thread(std::bind(&ComputePool::WorkerFunc, this, i), buf));
+        threads_.back()->Start();
+    }
+}
+
+ComputePool::~ComputePool()
+{
+    {
+        std::lock_guard<std::mutex> lock(SleepMutex_);
+        running_ = false;
+    }
+    SleepCond_.notify_all();
+    for (auto& thread : threads_)
+    {
+        thread->Join();
+    }
+}
+
+ComputePool* ComputePool::Default()
+{
+    // 进程退出时loop可能已经析构, 不能再投递continuation, 所以默认线程池不销毁
+    static ComputePool* pool = new ComputePool(static_cast<int>(std::thread::hardware_concurrency()));
+    return pool;
+}
+
+void ComputePool::Submit(Task task, EventLoop* loop, Task continuation)
+{
+    size_t index;
+    if (t_CurrentPool == this)
+    {
+        index = t_WorkerIndex; // 任务中又提交的任务, 留在本worker上, 数据还在cache中
+    }
+    else
+    {
+        index = NextWorker_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
+    }
+
+    // 先计数再入队, 计数不会小于队列中的任务数, worker看到计数但还没取到任务时会重试而不是睡眠
+    // 与WorkerFunc中先增加IdleWorkers_再检查QueuedJobs_配对, 两边至少有一边能看到对方
+    QueuedJobs_.fetch_add(1);
+    Worker* worker = workers_[index].get();
+    {
+        std::lock_guard<std::mutex> lock(worker->mutex);
+        worker->jobs.push_back(Job{std::move(task), loop, std::move(continuation)});
+    }
+
+    if (IdleWorkers_.load() > 0)
+    {
+        std::lock_guard<std::mutex> lock(SleepMutex_);
+        SleepCond_.notify_one();
+    }
+}
+
+bool ComputePool::PopJob(int index, Job* job)
+{
+    {
+        Worker* self = workers_[index].get();
+        std::lock_guard<std::mutex> lock(self->mutex);
+        if (!self->jobs.empty())
+        {
+            *job = std::move(self->jobs.back());
+            self->jobs.pop_back();
+            QueuedJobs_.fetch_sub(1);
+            return true;
+        }
+    }
+
+    // 自己的队列空了, 从其他worker的队头偷最早提交的任务
+    for (size_t i = 1; i < workers_.size(); i++)
+    {
+        Worker* victim = workers_[(index + i) % workers_.size()].get();
+        std::lock_guard<std::mutex> lock(victim->mutex);
+        if (!victim->jobs.empty())
+        {
+            *job = std::move(victim->jobs.front());
+            victim->jobs.pop_front();
+            QueuedJobs_.fetch_sub(1);
+            return true;
+        }
+    }
+    return false;
+}
+
+void ComputePool::WorkerFunc(int index)
+{
+    t_CurrentPool = this;
+    t_WorkerIndex = index;
+    Worker* worker = workers_[index].get();
+
+    while (true)
+    {
+        Job job;
+        if (PopJob(index, &job))
+        {
+            int64_t start = NowUs();
+            job.task();
+            int64_t end = NowUs();
+            TasksExecuted_.fetch_add(1, std::memory_order_relaxed);
+            if (job.loop != nullptr && job.continuation)
+            {
+                if (worker->completions.empty())
+                {
+                    worker->FirstCompletionUs = end;
+                }
+                worker->completions.emplace_back(job.loop, std::move(job.continuation));
+            }
+            // 任务本身就很耗时的话, 合并省下的唤醒微不足道, 不再让continuation等下一个任务
+            if (worker->completions.size() >= kMaxCompletionBatch ||
+                (!worker->completions.empty() &&
+                 (end - worker->FirstCompletionUs >= kMaxCompletionDelayUs || end - start >= kMaxCompletionDelayUs)))
+            {
+                FlushCompletions(worker);
+            }
+            continue;
+        }
+
+        // 没有任务可做, 睡眠之前先把攒下的continuation投递出去
+        FlushCompletions(worker);
+
+        std::unique_lock<std::mutex> lock(SleepMutex_);
+        IdleWorkers_.fetch_add(1);
+        while (running_ && QueuedJobs_.load() == 0)
+        {
+            SleepCond_.wait(lock);
+        }
+        IdleWorkers_.fetch_sub(1);
+        if (!running_ && QueuedJobs_.load() == 0)
+        {
+            break;
+        }
+    }
+}
+
+static void RunContinuations(const std::vector<ComputePool::Task>& continuations)
+{
+    for (const ComputePool::Task& continuation : continuations)
+    {
+        continuation();
+    }
+}
+
+void ComputePool::FlushCompletions(Worker* worker)
+{
+    std::vector<std::pair<EventLoop*, Task>>& completions = worker->completions;
+    while (!completions.empty())
+    {
+        // 取出属于同一个loop的continuation, 合并成一个回调
+        EventLoop* loop = completions.front().first;
+        std::vector<Task> batch;
+        size_t kept = 0;
+        for (size_t i = 0; i < completions.size(); i++)
+        {
+            if (completions[i].first == loop)
+            {
+                batch.push_back(std::move(completions[i].second));
+            }
+            else
+            {
+                completions[kept++] = std::move(completions[i]);
+            }
+        }
+        completions.resize(kept);
+
+        CompletionBatches_.fetch_add(1, std::memory_order_relaxed);
+        // 计算结果的回写属于批量工作, 受loop的kBulk预算限制, 不会挤占IO处理
+        loop->QueneInLoop(std::bind(&RunContinuations, std::move(batch)), EventLoop::kBulk);
+    }
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <string>
+
+#include "noncopyable.h"
+
+class EventLoop;
+class Thread;
+
+/*
+work-stealing的计算线程池, 用于把CPU密集的请求处理移出IO线程
+每个worker有自己的任务队列, 从队尾取自己的任务, 空闲时从其他worker的队头偷任务
+任务完成后continuation回到提交任务的EventLoop执行, 同一个worker完成的多个continuation
+按loop合并成一个回调投递, 连续完成的任务只触发一次唤醒
+*/
+class ComputePool: noncopyable
+{
+public:
+    using Task = std::function<void()>;
+
+    explicit ComputePool(int num_threads, const std::string& name = "ComputePool");
+    ~ComputePool();
+
+    // 在worker线程中执行task, 完成后在loop中执行continuation(可以为空), 可以在任意线程调用
+    void Submit(Task task, EventLoop* loop = nullptr, Task continuation = Task());
+
+    int NumThreads() const { return static_cast<int>(workers_.size()); }
+
+    // 累计执行的任务数, 以及continuation投递到loop的批次数
+    uint64_t TasksExecuted() const { return TasksExecuted_.load(std::memory_order_relaxed); }
+    uint64_t CompletionBatches() const { return CompletionBatches_.load(std::memory_order_relaxed); }
+
+    // EventLoop::Offload默认使用的线程池, 线程数等于CPU核数, 第一次使用时创建, 进程退出时不销毁
+    static ComputePool* Default();
+
+private:
+    struct Job
+    {
+        Task task;
+        EventLoop* loop;
+        Task continuation;
+    };
+
+    struct Worker
+    {
+        std::mutex mutex; // 保护jobs, worker自己和偷任务的worker都会访问
+        std::deque<Job> jobs;
+        // 已完成, 还没有投递给loop的continuation, 只在worker线程中访问
+        std::vector<std::pair<EventLoop*, Task>> completions;
+        int64_t FirstCompletionUs; // completions中第一个continuation的完成时间
+    };
+
+    void WorkerFunc(int index);
+    bool PopJob(int index, Job* job); // 先取自己的任务, 再从其他worker偷
+    void FlushCompletions(Worker* worker);
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::unique_ptr<Thread>> threads_;
+    std::atomic<size_t> NextWorker_; // 外部线程提交任务时轮流放入各个worker的队列
+
+    std::atomic<size_t> QueuedJobs_; // 所有队列中还没有被取走的任务数
+    std::atomic_int IdleWorkers_;
+    std::mutex SleepMutex_;
+    std::condition_variable SleepCond_;
+    std::atomic_bool running_;
+
+    std::atomic<uint64_t> TasksExecuted_;
+    std::atomic<uint64_t> CompletionBatches_;
+};
@@ -0,0 +1,132 @@
+#include <sys/socket.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "Connector.h"
+#include "Channel.h"
+#include "EventLoop.h"
+#include "TcpConnection.h"
+#include "Logger.h"
+
+std::atomic_int Connector::NextConnId_(1);
+
+Connector::Connector(EventLoop* loop, const InetAddress& server_addr, ConnectCallback cb)
+    : loop_(loop)
+    , ServerAddr_(server_addr)
+    , callback_(std::move(cb))
+{}
+
+void Connector::Connect(EventLoop* loop, const InetAddress& server_addr, ConnectCallback cb)
+{
+    std::shared_ptr<Connector> connector(new Connector(loop, server_addr, std::move(cb)));
+    loop->RunInLoop(std::bind(&Connector::StartInLoop, connector));
+}
+
+ConnectAwaiter Connector::AsyncConnect(EventLoop* loop, const InetAddress& server_addr)
+{
+    return ConnectAwaiter(loop, server_addr);
+}
+
+void Connector::StartInLoop()
+{
+    int sockfd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (sockfd < 0)
+    {
+        LOG_ERROR("Connector::StartInLoop socket error: %d\n", errno);
+        Finish(-1);
+        return;
+    }
+
+    int ret = connect(sockfd, (sockaddr*)ServerAddr_.GetSockAddr(), sizeof(sockaddr_in));
+    if (ret == 0)
+    {
+        Finish(sockfd); // 本机连接可能立即完成
+    }
+    else if (errno == EINPROGRESS || errno == EINTR)
+    {
+        // Channel的回调持有Connector, 完成之后释放Channel, 打破循环引用
+        channel_.reset(new Channel(loop_, sockfd));
+        channel_->SetWriteCallback(std::bind(&Connector::HandleConnect, shared_from_this()));
+        channel_->SetErrorCallback(std::bind(&Connector::HandleConnect, shared_from_this()));
+        channel_->SetCloseCallback(std::bind(&Connector::HandleConnect, shared_from_this()));
+        channel_->EnableWriting();
+    }
+    else
+    {
+        LOG_ERROR("Connector::StartInLoop connect %s error: %d\n", ServerAddr_.ToIpPort().c_str(), errno);
+        close(sockfd);
+        Finish(-1);
+    }
+}
+
+void Connector::HandleConnect()
+{
+    // 出错时close/error/write回调可能在同一次事件中先后执行, 只处理第一次
+    if (!channel_ || channel_->IsNoneEvent())
+    {
+        return;
+    }
+    int sockfd = channel_->Fd();
+    channel_->DisableAll();
+    channel_->Remove();
+    // 正在Channel的回调中, 不能在这里析构它
+    loop_->QueneInLoop(std::bind(&Connector::ResetChannel, shared_from_this()));
+
+    int err = 0;
+    socklen_t len = sizeof(err);
+    if (getsockopt(sockfd, SOL_SOCKET, SO_ERROR, &err, &len) < 0)
+    {
+        err = errno;
+    }
+    if (err != 0)
+    {
+        LOG_ERROR("Connector::HandleConnect connect %s error: %s\n", ServerAddr_.ToIpPort().c_str(), strerror(err));
+        close(sockfd);
+        Finish(-1);
+        return;
+    }
+    Finish(sockfd);
+}
+
+void Connector::Finish(int sockfd)
+{
+    if (sockfd < 0)
+    {
+        callback_(TcpConnectionPtr());
+        return;
+    }
+
+    sockaddr_in local;
+    bzero(&local, sizeof(local));
+    socklen_t addr_len = sizeof(local);
+    if (getsockname(sockfd, (sockaddr*)&local, &addr_len) < 0)
+    {
+        LOG_ERROR("Connector::Finish getsockname error: %d\n", errno);
+    }
+
+    char buf[64];
+    snprintf(buf, sizeof(buf), "-%s#%d", ServerAddr_.ToIpPort().c_str(), NextConnId_++);
+    TcpConnectionPtr conn = std::allocate_shared<TcpConnection>(SlabAllocator<TcpConnection>(),
+                                                                loop_, std::string("Connector") + buf, sockfd,
+                                                                InetAddress(local), ServerAddr_);
+    conn->SetConnectionCallback([](const TcpConnectionPtr&) {});
+    conn->SetCloseCallback(std::bind(&Connector::HandleClose, shared_from_this()));
+    conn_ = conn;
+    conn->ConnectEstablished();
+    callback_(conn);
+}
+
+void Connector::HandleClose()
+{
+    // 正在连接的回调中, 与TcpServer::RemoveConnectionInLoop一样排到之后再ConnectDestoryed
+    loop_->QueneInLoop(std::bind(&Connector::RemoveConnection, shared_from_this()));
+}
+
+void Connector::RemoveConnection()
+{
+    TcpConnectionPtr conn;
+    conn.swap(conn_);
+    conn->ConnectDestoryed();
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <atomic>
+#include <string>
+
+#include "noncopyable.h"
+#include "InetAddress.h"
+#include "Callbacks.h"
+
+class Channel;
+class EventLoop;
+class ConnectAwaiter;
+
+/*
+主动发起的客户端连接: 非阻塞connect, 等socket可写后检查SO_ERROR
+成功后在loop中创建TcpConnection并ConnectEstablished, 连接关闭时自动ConnectDestoryed
+连接不属于任何TcpServer, 收到的数据用MessageCallback或协程读取
+建立之后由Connector持有到ConnectDestoryed为止, 用户提前丢弃TcpConnectionPtr时Channel不会留在Poller中
+*/
+class Connector: noncopyable, public std::enable_shared_from_this<Connector>
+{
+public:
+    // 连接失败时参数为nullptr
+    using ConnectCallback = std::function<void(const TcpConnectionPtr&)>;
+
+    // 在loop中连接server_addr, 完成后在loop中执行cb, 可以跨线程调用
+    static void Connect(EventLoop* loop, const InetAddress& server_addr, ConnectCallback cb);
+    // 协程版本(C++20), co_await得到连接, 失败时为nullptr, 协程在loop中恢复
+    static ConnectAwaiter AsyncConnect(EventLoop* loop, const InetAddress& server_addr);
+
+private:
+    Connector(EventLoop* loop, const InetAddress& server_addr, ConnectCallback cb);
+
+    void StartInLoop();
+    void HandleConnect(); // socket可写或出错
+    void Finish(int sockfd); // sockfd < 0表示失败
+    void ResetChannel() { channel_.reset(); }
+    void HandleClose(); // 连接的CloseCallback
+    void RemoveConnection(); // 在loop中ConnectDestoryed, 然后释放持有的连接
+
+    EventLoop* loop_;
+    const InetAddress ServerAddr_;
+    ConnectCallback callback_;
+    std::unique_ptr<Channel> channel_; // 等待connect完成期间存在
+    TcpConnectionPtr conn_; // 连接的CloseCallback持有Connector, RemoveConnection时释放, 打破循环引用
+
+    static std::atomic_int NextConnId_;
+};
+
+class ConnectAwaiter
+{
+public:
+    ConnectAwaiter(EventLoop* loop, const InetAddress& server_addr): loop_(loop), ServerAddr_(server_addr) {}
+
+    bool await_ready() const { return false; }
+    template <typename Handle>
+    void await_suspend(Handle handle)
+    {
+        Connector::Connect(loop_, ServerAddr_, [this, handle](const TcpConnectionPtr& conn) {
+            conn_ = conn;
+            handle.resume();
+        });
+    }
+    TcpConnectionPtr await_resume() { return std::move(conn_); }
+
+private:
+    EventLoop* loop_;
+    InetAddress ServerAddr_;
+    TcpConnectionPtr conn_;
+};
@@ -0,0 +1,156 @@
+#pragma once
+
+/*
+协程类型, 需要用C++20编译使用方的代码, 库本身仍然是C++11
+可以co_await的对象: TcpConnection::Read/ReadUntil/Write, EventLoop::Sleep, Connector::AsyncConnect, 以及CoTask
+这些等待对象在loop线程中直接恢复协程, 不经过回调队列, 也不切换线程
+
+    CoTask<> Session(TcpConnectionPtr conn)
+    {
+        while (true)
+        {
+            std::string line = co_await conn->ReadUntil("\r\n");
+            if (!conn->Connected()) break;
+            co_await conn->Write(line);
+        }
+    }
+    server.SetConnectionCallback([](const TcpConnectionPtr& conn) {
+        if (conn->Connected()) CoSpawn(Session(conn));
+    });
+*/
+#if __cplusplus < 202002L
+#error "Coroutine.h requires C++20"
+#endif
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+#include "Logger.h"
+#include "EventLoop.h"
+#include "TcpConnection.h"
+#include "Connector.h"
+
+template <typename T = void>
+class CoTask;
+
+// CoTask结束时恢复等待它的协程(对称转移, 不增加调用栈深度)
+struct CoPromiseBase
+{
+    struct FinalAwaiter
+    {
+        bool await_ready() const noexcept { return false; }
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+        {
+            std::coroutine_handle<> continuation = handle.promise().continuation;
+            return continuation ? continuation : std::noop_coroutine();
+        }
+        void await_resume() const noexcept {}
+    };
+
+    std::suspend_always initial_suspend() const noexcept { return {}; } // co_await时才开始执行
+    FinalAwaiter final_suspend() const noexcept { return {}; }
+    void unhandled_exception() { exception = std::current_exception(); }
+
+    std::coroutine_handle<> continuation;
+    std::exception_ptr exception;
+};
+
+template <typename T>
+struct CoPromise: CoPromiseBase
+{
+    CoTask<T> get_return_object();
+    void return_value(T value) { result.emplace(std::move(value)); }
+
+    T TakeResult()
+    {
+        if (exception)
+        {
+            std::rethrow_exception(exception);
+        }
+        return std::move(*result);
+    }
+
+    std::optional<T> result;
+};
+
+template <>
+struct CoPromise<void>: CoPromiseBase
+{
+    CoTask<void> get_return_object();
+    void return_void() {}
+
+    void TakeResult()
+    {
+        if (exception)
+        {
+            std::rethrow_exception(exception);
+        }
+    }
+};
+
+// 惰性启动的协程, 被co_await时才开始执行, 结束后回到等待它的协程
+template <typename T>
+class CoTask
+{
+public:
+    using promise_type = CoPromise<T>;
+
+    explicit CoTask(std::coroutine_handle<promise_type> handle): handle_(handle) {}
+    CoTask(CoTask&& other) noexcept: handle_(std::exchange(other.handle_, nullptr)) {}
+    CoTask(const CoTask&) = delete;
+    CoTask& operator=(const CoTask&) = delete;
+    ~CoTask()
+    {
+        if (handle_)
+        {
+            handle_.destroy();
+        }
+    }
+
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) noexcept
+    {
+        handle_.promise().continuation = continuation;
+        return handle_;
+    }
+    T await_resume() { return handle_.promise().TakeResult(); }
+
+private:
+    std::coroutine_handle<promise_type> handle_;
+};
+
+template <typename T>
+CoTask<T> CoPromise<T>::get_return_object()
+{
+    return CoTask<T>(std::coroutine_handle<CoPromise<T>>::from_promise(*this));
+}
+
+inline CoTask<void> CoPromise<void>::get_return_object()
+{
+    return CoTask<void>(std::coroutine_handle<CoPromise<void>>::from_promise(*this));
+}
+
+// CoSpawn使用的协程, 立即执行, 结束时自动销毁
+struct CoDetached
+{
+    struct promise_type
+    {
+        CoDetached get_return_object() const noexcept { return {}; }
+        std::suspend_never initial_suspend() const noexcept { return {}; }
+        std::suspend_never final_suspend() const noexcept { return {}; }
+        void return_void() const noexcept {}
+        void unhandled_exception() const noexcept
+        {
+            LOG_FATAL("CoSpawn: unhandled exception in coroutine\n");
+        }
+    };
+};
+
+// 在当前线程中启动task, 运行到第一次挂起时返回, 之后由等待对象所在的loop恢复; 协程中抛出的异常是致命错误
+inline CoDetached CoSpawn(CoTask<void> task)
+{
+    co_await std::move(task);
+}
@@ -2,6 +2,8 @@
 
 #include "Poller.h"
 #include "EpollPoller.h"
+#include "IoUringPoller.h"
+#include "Logger.h"
 
 /*
 为什么要额外写一个DefaultPoller.cc来实现NewDefaultPoller方法
@@ -9,14 +11,25 @@
 PollPoller.h和EpollPoller.h, 在基类实现中引用派生类头文件, 这是不合适的
 */
 
-Poller* Poller::NewDefaultPoller(EventLoop* loop)
+Poller* Poller::NewDefaultPoller(EventLoop* loop, Backend backend)
 {
-    if (getenv("MUDUO_USE_POLL"))
+    if (backend == kDefaultBackend)
     {
-        return nullptr; // poll实例
+        if (getenv("MUDUO_USE_POLL"))
+        {
+            return nullptr; // poll实例
+        }
+        backend = getenv("MUDUO_USE_IOURING") ? kIoUringBackend : kEpollBackend;
     }
-    else
+
+    if (backend == kIoUringBackend)
     {
-        return new EpollPoller(loop); // epoll实例
-    } 
-}
\ No newline at end of file
+        if (IoUringPoller::Available())
+        {
+            return new IoUringPoller(loop); // io_uring实例
+        }
+        LOG_ERROR("io_uring is not available, fall back to epoll\n");
+    }
+
+    return new EpollPoller(loop); // epoll实例
+}
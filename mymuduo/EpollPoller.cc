@@ -9,7 +9,7 @@
 /*
                     EventLoop
         ChannelList             Poller
-                        ChannelMap<fd, Channel*>
+                        ChannelTable[fd] = Channel*
 */
 
 // Channel未添加到Poller中
@@ -35,8 +35,9 @@ EpollPoller::~EpollPoller()
 
 TimeStamp EpollPoller::Poll(int timeout_ms, ChannelList* active_channels) // epoll_wait
 {
-    // LOG_DEBUG更为合理
-    LOG_INFO("func = %s ==> fd total count: %lu\n", __FUNCTION__, channels_.size());
+    LOG_DEBUG("func = %s ==> fd total count: %lu\n", __FUNCTION__, channels_.size());
+
+    FlushPendingChannels();
 
     int num_events = epoll_wait(epollfd_, &*events_.begin(), static_cast<int>(events_.size()), timeout_ms);
 
@@ -45,7 +46,7 @@ TimeStamp EpollPoller::Poll(int timeout_ms, ChannelList* active_channels) // epo
 
     if (num_events > 0)
     {
-        LOG_INFO("%d events happened!\n", num_events);
+        LOG_DEBUG("%d events happened!\n", num_events);
         FillActiveChannels(num_events, active_channels);
         if (num_events == events_.size())
         {
@@ -68,44 +69,41 @@ TimeStamp EpollPoller::Poll(int timeout_ms, ChannelList* active_channels) // epo
     return now;
 }
 
-// Channel Update Remove ==> EventLoop UpdateChannel RemoveChannel ==> Poller UpdateChannel RemoveChannel
-void EpollPoller::UpdateChannel(Channel* channel) // epoll_ctl
+/*
+Channel Update Remove ==> EventLoop UpdateChannel RemoveChannel ==> Poller UpdateChannel RemoveChannel
+UpdateChannel只把Channel记入待提交列表, 下一次Poll之前再和内核中已注册的事件比较, 决定ADD/MOD/DEL
+同一轮中EnableWriting后又DisableWriting这样的来回变化, 最终和内核状态一致, 不会产生epoll_ctl
+index_表示Channel在内核中的状态: kAdded已注册到epoll, kDeleted在channels_中但没有注册到epoll
+*/
+void EpollPoller::UpdateChannel(Channel* channel)
 {
     const int index = channel->Index();
-    LOG_INFO("func = %s ==> fd = %d, events = %d, index = %d\n", __FUNCTION__, channel->Fd(), channel->Events(), index);
-    if (index == kNew || index == kDeleted)
-    {
-        if (index == kNew)
-        {
-            int fd = channel->Fd();
-            channels_[fd] = channel;
-        }
+    LOG_DEBUG("func = %s ==> fd = %d, events = %d, index = %d\n", __FUNCTION__, channel->Fd(), channel->Events(), index);
+    ++InterestChanges_;
 
-        channel->SetIndex(kAdded);
-        Update(EPOLL_CTL_ADD, channel);
-    }
-    else // Channel已经在Poller上注册过了
+    if (index == kNew)
     {
         int fd = channel->Fd();
-        if (channel->IsNoneEvent())
-        {
-            Update(EPOLL_CTL_DEL, channel);
-            channel->SetIndex(kDeleted);
-        }
-        else
-        {
-            Update(EPOLL_CTL_MOD, channel);
-        }
-    }    
+        channels_.Insert(fd, channel);
+        channel->SetIndex(kDeleted);
+    }
+
+    if (channel->PendingIndex() < 0)
+    {
+        channel->SetPendingIndex(static_cast<int>(PendingChannels_.size()));
+        PendingChannels_.push_back(channel);
+    }
 }
 
-// 从Poller中删除Channel
+// 从Poller中删除Channel, 调用之后Channel可能马上被析构, 所以立即生效
 void EpollPoller::RemoveChannel(Channel* channel) // epoll_ctl
 {
     int fd = channel->Fd();
-    channels_.erase(fd);
+    channels_.Erase(fd);
+
+    LOG_DEBUG("func = %s ==> fd = %d\n", __FUNCTION__, fd);
 
-    LOG_INFO("func = %s ==> fd = %d\n", __FUNCTION__, fd);
+    RemovePending(channel);
 
     int index = channel->Index();
     if (index == kAdded)
@@ -115,6 +113,50 @@ void EpollPoller::RemoveChannel(Channel* channel) // epoll_ctl
     channel->SetIndex(kNew);
 }
 
+void EpollPoller::FlushPendingChannels()
+{
+    for (Channel* channel : PendingChannels_)
+    {
+        channel->SetPendingIndex(-1);
+
+        const int index = channel->Index();
+        if (index == kAdded)
+        {
+            if (channel->IsNoneEvent())
+            {
+                Update(EPOLL_CTL_DEL, channel);
+                channel->SetIndex(kDeleted);
+            }
+            else if (channel->Events() != channel->RegisteredEvents())
+            {
+                Update(EPOLL_CTL_MOD, channel);
+            }
+        }
+        else if (!channel->IsNoneEvent()) // kDeleted
+        {
+            channel->SetIndex(kAdded);
+            Update(EPOLL_CTL_ADD, channel);
+        }
+    }
+    PendingChannels_.clear();
+}
+
+// 把Channel从待提交列表中摘除, 和末尾元素交换, O(1)
+void EpollPoller::RemovePending(Channel* channel)
+{
+    int pos = channel->PendingIndex();
+    if (pos < 0)
+    {
+        return;
+    }
+
+    Channel* last = PendingChannels_.back();
+    PendingChannels_[pos] = last;
+    last->SetPendingIndex(pos);
+    PendingChannels_.pop_back();
+    channel->SetPendingIndex(-1);
+}
+
 // 填写活跃的连接
 void EpollPoller::FillActiveChannels(int num_events, ChannelList* active_channels) const
 {
@@ -137,6 +179,9 @@ void EpollPoller::Update(int operation, Channel* channel)
     event.data.fd = fd;
     event.data.ptr = channel;
 
+    ++InterestOps_;
+    channel->SetRegisteredEvents(operation == EPOLL_CTL_DEL ? 0 : event.events);
+
     if(epoll_ctl(epollfd_, operation, fd, &event) < 0)
     {
         if (operation == EPOLL_CTL_DEL)
@@ -23,9 +23,13 @@ private:
     void FillActiveChannels(int num_events, ChannelList* active_channels) const;
     // 更新Channel通道
     void Update(int operation, Channel* channel);
+    // 在epoll_wait之前, 把本轮积攒的interest变化一次性提交
+    void FlushPendingChannels();
+    void RemovePending(Channel* channel);
 
     using EventList = std::vector<epoll_event>;
 
     int epollfd_;
     EventList events_;
+    ChannelList PendingChannels_; // interest发生过变化, 还没有提交给内核的Channel
 };
\ No newline at end of file
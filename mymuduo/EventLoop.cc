@@ -2,18 +2,31 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <algorithm>
+#include <malloc.h>
 
 #include "EventLoop.h"
 #include "Logger.h"
 #include "Poller.h"
 #include "Channel.h"
+#include "TimerQueue.h"
+#include "TimingWheel.h"
+#include "ComputePool.h"
+#include "RingChannel.h"
+#include "SlabPool.h"
 
 // 防止一个线程创建多个EventLoop thread_local
 __thread EventLoop* t_LoopInThisThread = nullptr;
 
-// 定义默认的Poller IO复用接口的超时时间
+// 定义默认的Poller IO复用接口的超时时间, 有定时器时按最近的到期时间缩短
 const int kPollTimeMs = 10000;
 
+// 两次malloc_trim之间的最短间隔(秒)
+const double kMinTrimInterval = 1.0;
+
+// 统计loop忙碌占比的窗口长度
+const int64_t kBusyWindowUs = 100 * 1000;
+
 // 创建WakeupFd, 用来notify唤醒SubReactor处理新来的Channel
 int CreateEventfd()
 {
@@ -26,14 +39,34 @@ int CreateEventfd()
     return evtfd;
 }
 
-EventLoop::EventLoop()
+EventLoop::EventLoop(Poller::Backend backend)
     : looping_(false)
     , quit_(false)
-    , CallingPendingFunctors_(false)
     , ThreadId_(CurrentThread::Tid())
-    , poller_(Poller::NewDefaultPoller(this))
+    , BusyPollUs_(0)
+    , NumaNode_(-1)
+    , ComputePool_(nullptr)
+    , SlabPool_(new SlabPool())
+    , TrimPending_(false)
+    , poller_(Poller::NewDefaultPoller(this, backend))
+    , TimerQueue_(new TimerQueue(this))
     , WakeupFd_(CreateEventfd())
     , WakeupChannel_(new Channel(this, WakeupFd_))
+    , CallingPendingFunctors_(false)
+    , BulkBudgetUs_(0)
+    , BulkRollovers_(0)
+    , RingsPending_(false)
+    , WakeupPending_(false)
+    , WakeupWrites_(0)
+    , WakeupsCoalesced_(0)
+    , NumConnections_(0)
+    , refs_(0)
+    , FunctorsQueued_(0)
+    , FunctorsDone_(0)
+    , BusyUs_(0)
+    , BusyWindowStart_(TimeStamp::now())
+    , BusyPermille_(0)
+    , BusyUpdatedUs_(BusyWindowStart_.MicroSecondsSinceEpoch())
 {
     LOG_DEBUG("EventLoop created %p in thread %d\n", this, ThreadId_);
     if (t_LoopInThisThread)
@@ -43,6 +76,7 @@ EventLoop::EventLoop()
     else
     {
         t_LoopInThisThread = this;
+        SlabPool_->Attach();
     }
 
     // 设置wakeupfd的事件类型以及发生事件后的回调操作
@@ -57,6 +91,7 @@ EventLoop::~EventLoop()
     WakeupChannel_->Remove();
     close(WakeupFd_);
     t_LoopInThisThread = nullptr;
+    SlabPool_->Detach();
 }
 
 void EventLoop::Loop()
@@ -69,8 +104,16 @@ void EventLoop::Loop()
     while (!quit_)
     {
         ActiveChannels_.clear();
+        int timeout_ms = PollTimeoutMs();
+        if (BusyPollUs_ > 0 && timeout_ms != 0 &&
+            TimeStamp::now().MicroSecondsSinceEpoch() - LastActiveTime_.MicroSecondsSinceEpoch() < BusyPollUs_)
+        {
+            // 自旋期间loop每一轮都会检查回调队列, 把唤醒标志置上, 生产者就不必写eventfd
+            timeout_ms = 0;
+            WakeupPending_.store(true, std::memory_order_release);
+        }
         // 监听两类fd clit的fd和wakeupfd
-        PollReturnTime_ = poller_->Poll(kPollTimeMs, &ActiveChannels_);
+        PollReturnTime_ = poller_->Poll(timeout_ms, &ActiveChannels_);
         for (Channel* channel : ActiveChannels_)
         {
             // Poller监听哪些Channel发生事件, 然后上报给EventLoop, 通知Channel处理相应事件
@@ -81,12 +124,30 @@ void EventLoop::Loop()
         IO线程 mainloop ==> accept ==> fd ==> channel ==> subloop
         mainloop 事先注册一个回调cb(需要subloop执行) wakeup subloop后, 执行下面的方法, 执行之前mainloop注册的回调函数
         */
-        DoPendingFunctors();
+        // RingChannel的handler中投递的回调(比如通知生产者可写)紧接着在本轮执行
+        size_t functors = DoRingChannels();
+        functors += DoPendingFunctors();
+
+        if (!ActiveChannels_.empty() || functors > 0)
+        {
+            LastActiveTime_ = PollReturnTime_;
+        }
+        UpdateBusyTime();
     }
     LOG_INFO("EventLoop %p stop looping\n", this);
     looping_ = false;
 }
 
+void EventLoop::Offload(Functor task, Functor continuation)
+{
+    GetComputePool()->Submit(std::move(task), this, std::move(continuation));
+}
+
+ComputePool* EventLoop::GetComputePool() const
+{
+    return ComputePool_ != nullptr ? ComputePool_ : ComputePool::Default();
+}
+
 // 退出事件循环 1. loop在自己的线程中调用quit
 void EventLoop::Quit()
 {
@@ -98,6 +159,11 @@ void EventLoop::Quit()
     }
 }
 
+EventLoop* EventLoop::LoopOfCurrentThread()
+{
+    return t_LoopInThisThread;
+}
+
 // 在当前loop中执行cb
 void EventLoop::RunInLoop(Functor cb)
 {
@@ -107,23 +173,46 @@ void EventLoop::RunInLoop(Functor cb)
     }
     else // 在非当前的loop线程中执行cb, 需要唤醒loop所在线程, 执行cb
     {
-        QueneInLoop(cb);
+        QueneInLoop(std::move(cb));
     }
 }
 
 // 把cb放入队列中, 唤醒loop所在的线程, 执行cb
-void EventLoop::QueneInLoop(Functor cb)
+void EventLoop::QueneInLoop(Functor cb, Priority priority)
 {
+    FunctorsQueued_.fetch_add(1, std::memory_order_relaxed);
+    if (priority == kBulk)
     {
-        std::unique_lock<std::mutex> lock(mutex_);
-        PendingFunctors_.emplace_back(cb);
+        BulkFunctors_.Push(std::move(cb));
+    }
+    else
+    {
+        PendingFunctors_.Push(std::move(cb));
     }
 
     // 唤醒相应的, 需要执行上面回调操作的loop线程
     // CallingPendingFunctors_: 当前loop正在执行回调, 但是loop又有了新的回调
     if (!IsInLoopThread() || CallingPendingFunctors_)
     {
-        Wakeup(); // 唤醒loop所在线程
+        WakeupForPending(); // 唤醒loop所在线程
+    }
+}
+
+/*
+N次投递最多只写一次eventfd: 第一个把WakeupPending_置为true的生产者负责写, 其余的直接返回
+loop在DoPendingFunctors开始时清除标志, 之后再入队的回调会重新唤醒loop
+生产者先入队再交换标志, loop先交换标志再出队, 所以看到标志已被设置的生产者, 它的回调一定会被这一轮执行
+*/
+void EventLoop::WakeupForPending()
+{
+    if (!WakeupPending_.exchange(true, std::memory_order_acq_rel))
+    {
+        WakeupWrites_.fetch_add(1, std::memory_order_relaxed);
+        Wakeup();
+    }
+    else
+    {
+        WakeupsCoalesced_.fetch_add(1, std::memory_order_relaxed);
     }
 }
 
@@ -138,6 +227,95 @@ void EventLoop::Wakeup()
     }
 }
 
+TimerId EventLoop::RunAt(TimeStamp time, TimerCallback cb)
+{
+    return TimerQueue_->AddTimer(std::move(cb), time, 0.0);
+}
+
+TimerId EventLoop::RunAfter(double delay, TimerCallback cb)
+{
+    TimeStamp time(AddTime(TimeStamp::now(), delay));
+    return RunAt(time, std::move(cb));
+}
+
+TimerId EventLoop::RunEvery(double interval, TimerCallback cb)
+{
+    TimeStamp time(AddTime(TimeStamp::now(), interval));
+    return TimerQueue_->AddTimer(std::move(cb), time, interval);
+}
+
+SleepAwaiter EventLoop::Sleep(int64_t milliseconds)
+{
+    return SleepAwaiter(this, milliseconds);
+}
+
+void EventLoop::Cancel(TimerId timerid)
+{
+    TimerQueue_->Cancel(timerid);
+}
+
+TimingWheel* EventLoop::GetTimingWheel()
+{
+    if (!TimingWheel_)
+    {
+        TimingWheel_.reset(new TimingWheel(this, 1.0));
+    }
+    return TimingWheel_.get();
+}
+
+void EventLoop::TrimMemory()
+{
+    if (TrimPending_)
+    {
+        return;
+    }
+    TrimPending_ = true;
+    // malloc_trim(0)要遍历整个堆, 距离上一次不到kMinTrimInterval时推迟到那时, 期间收缩的连接一起处理
+    TimeStamp next = AddTime(LastTrimTime_, kMinTrimInterval);
+    if (TimeStamp::now() < next)
+    {
+        RunAt(next, std::bind(&EventLoop::DoTrimMemory, this));
+    }
+    else
+    {
+        // 放到kBulk回调中, 时间轮同一个tick中到期的多个连接只触发一次
+        QueneInLoop(std::bind(&EventLoop::DoTrimMemory, this), kBulk);
+    }
+}
+
+void EventLoop::DoTrimMemory()
+{
+    TrimPending_ = false;
+    LastTrimTime_ = TimeStamp::now();
+    // 只释放超出目标的空闲块, 常用级别的空闲链表留给之后的新连接
+    SlabPool_->Trim(SlabPool::kDefaultTrimTarget);
+    malloc_trim(0);
+}
+
+int EventLoop::PollTimeoutMs() const
+{
+    // 上一轮有kBulk回调超出预算没有执行, 或者RingChannel还有消息, 只检查一下IO事件, 不阻塞
+    if (!BulkFunctors_.Empty() || RingsPending_.load(std::memory_order_relaxed))
+    {
+        return 0;
+    }
+
+    TimeStamp earliest = TimerQueue_->EarliestExpiration();
+    if (!earliest.Valid())
+    {
+        return kPollTimeMs;
+    }
+
+    // 向上取整到毫秒, 避免在到期前提前醒来空转
+    int64_t microseconds = earliest.MicroSecondsSinceEpoch() - TimeStamp::now().MicroSecondsSinceEpoch();
+    if (microseconds <= 0)
+    {
+        return 0;
+    }
+    int64_t ms = (microseconds + 999) / 1000;
+    return ms < kPollTimeMs ? static_cast<int>(ms) : kPollTimeMs;
+}
+
 void EventLoop::UpdateChannel(Channel* channel)
 {
     poller_->UpdateChannel(channel);
@@ -150,26 +328,128 @@ void EventLoop::RemoveChannel(Channel* channel)
 
 bool EventLoop::HasChannel(Channel* channel)
 {
-    poller_->HasChannel(channel);
+    return poller_->HasChannel(channel);
 }
 
 // 执行回调
-void EventLoop::DoPendingFunctors()
+size_t EventLoop::DoPendingFunctors()
 {
-    std::vector<Functor> functors;
     CallingPendingFunctors_ = true;
+    WakeupPending_.exchange(false, std::memory_order_acq_rel);
+
+    // 只执行开始时已经入队的回调, 执行期间新加入的回调会唤醒loop, 留到下一轮
+    // kUrgent回调全部执行, 先于kBulk回调, 不会排在一批数据处理后面
+    size_t count = PendingFunctors_.ConsumeAll([](const Functor& functor) {
+        functor(); // 执行当前loop需要执行的回调
+    });
 
+    if (BulkBudgetUs_ > 0)
     {
-        std::unique_lock<std::mutex> lock(mutex_);
-        functors.swap(PendingFunctors_);
+        int64_t deadline = TimeStamp::now().MicroSecondsSinceEpoch() + BulkBudgetUs_;
+        count += BulkFunctors_.ConsumeWhile([](const Functor& functor) {
+            functor();
+        }, [deadline]() {
+            return TimeStamp::now().MicroSecondsSinceEpoch() < deadline;
+        });
+        if (!BulkFunctors_.Empty())
+        {
+            BulkRollovers_.fetch_add(1, std::memory_order_relaxed);
+        }
     }
-
-    for (const Functor& functor : functors)
+    else
     {
-        functor(); // 执行当前loop需要执行的回调
+        count += BulkFunctors_.ConsumeAll([](const Functor& functor) {
+            functor();
+        });
     }
 
     CallingPendingFunctors_ = false;
+    FunctorsDone_.store(FunctorsDone_.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+    return count;
+}
+
+void EventLoop::AddRingChannel(const std::shared_ptr<RingChannelBase>& channel)
+{
+    RingChannels_.push_back(channel);
+    // 注册之前可能已经有消息入队并通知过
+    RingsPending_.store(true);
+}
+
+void EventLoop::RemoveRingChannel(const std::shared_ptr<RingChannelBase>& channel)
+{
+    size_t handled;
+    while (channel->Drain(&handled)) {}
+    RingChannels_.erase(std::remove(RingChannels_.begin(), RingChannels_.end(), channel), RingChannels_.end());
+}
+
+void EventLoop::WakeupRingChannels()
+{
+    RingsPending_.store(true);
+    if (!IsInLoopThread())
+    {
+        WakeupForPending();
+    }
+}
+
+/*
+在DoPendingFunctors之前执行, 清除RingsPending_之后才通知的通道:
+要么生产者交换WakeupPending_时loop已经清除了它, 会写eventfd; 要么还没有清除, 生产者不写,
+但PollTimeoutMs在这之后检查RingsPending_, 下一轮不会阻塞
+*/
+size_t EventLoop::DoRingChannels()
+{
+    if (!RingsPending_.exchange(false))
+    {
+        return 0;
+    }
+
+    size_t count = 0;
+    bool more = false;
+    // 消息的handler可能注册新的通道, 按下标遍历; 注销总是通过回调队列, 不会发生在遍历期间
+    for (size_t i = 0; i < RingChannels_.size(); i++)
+    {
+        size_t handled;
+        more = RingChannels_[i]->Drain(&handled) || more;
+        count += handled;
+    }
+    if (more)
+    {
+        RingsPending_.store(true);
+    }
+    return count;
+}
+
+size_t EventLoop::PendingFunctors() const
+{
+    uint64_t done = FunctorsDone_.load(std::memory_order_relaxed);
+    uint64_t queued = FunctorsQueued_.load(std::memory_order_relaxed);
+    return queued > done ? static_cast<size_t>(queued - done) : 0;
+}
+
+int EventLoop::BusyPermille() const
+{
+    // 空闲的loop阻塞在Poll中, 不会发布新的占比, 超过两个窗口没有更新就认为是空闲的
+    int64_t updated = BusyUpdatedUs_.load(std::memory_order_relaxed);
+    if (TimeStamp::now().MicroSecondsSinceEpoch() - updated > 2 * kBusyWindowUs)
+    {
+        return 0;
+    }
+    return BusyPermille_.load(std::memory_order_relaxed);
+}
+
+// 忙碌时间是Poll返回之后处理事件和回调的时间, 每100ms发布一次占比
+void EventLoop::UpdateBusyTime()
+{
+    TimeStamp now(TimeStamp::now());
+    BusyUs_ += now.MicroSecondsSinceEpoch() - PollReturnTime_.MicroSecondsSinceEpoch();
+    int64_t window = now.MicroSecondsSinceEpoch() - BusyWindowStart_.MicroSecondsSinceEpoch();
+    if (window >= kBusyWindowUs)
+    {
+        BusyPermille_.store(static_cast<int>(BusyUs_ * 1000 / window), std::memory_order_relaxed);
+        BusyUpdatedUs_.store(now.MicroSecondsSinceEpoch(), std::memory_order_relaxed);
+        BusyUs_ = 0;
+        BusyWindowStart_ = now;
+    }
 }
 
 void EventLoop::HandleRead()
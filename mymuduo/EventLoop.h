@@ -4,14 +4,22 @@
 #include <vector>
 #include <atomic>
 #include <memory>
-#include <mutex>
 
 #include "noncopyable.h"
 #include "Timestamp.h"
 #include "CurrentThread.h"
+#include "Poller.h"
+#include "Callbacks.h"
+#include "TimerId.h"
+#include "MpscQueue.h"
 
 class Channel;
-class Poller;
+class TimerQueue;
+class TimingWheel;
+class ComputePool;
+class RingChannelBase;
+class SleepAwaiter;
+class SlabPool;
 
 // 事件循环类, 主要包含了两大模块 Channel Poller(epoll的抽象)
 class EventLoop: noncopyable
@@ -19,7 +27,8 @@ class EventLoop: noncopyable
 public:
     using Functor = std::function<void()>;
 
-    EventLoop();
+    // backend指定底层的IO复用实现, 默认由环境变量决定
+    explicit EventLoop(Poller::Backend backend = Poller::kDefaultBackend);
     ~EventLoop();
 
     // 开启/退出事件循环
@@ -28,25 +37,106 @@ public:
 
     TimeStamp PollReturnTime() const { return PollReturnTime_; }
 
+    // busy poll: 最近spin_us微秒内有事件或回调时, 用0超时轮询代替阻塞等待, 0表示关闭
+    // 用CPU换取唤醒延迟, 只能在loop线程中或者Loop()开始之前调用
+    void SetBusyPoll(int64_t spin_us) { BusyPollUs_ = spin_us; }
+
+    // loop线程所在的NUMA节点, -1表示没有绑定, 由EventLoopThread设置
+    void SetNumaNode(int node) { NumaNode_ = node; }
+    int NumaNode() const { return NumaNode_; }
+
+    // 回调的优先级, 每个优先级一个队列, 同一优先级内按投递顺序执行, 不同优先级之间不保证顺序
+    enum Priority
+    {
+        kUrgent, // 控制类回调(建立/销毁连接, 关闭等), 每一轮全部执行
+        kBulk,   // 批量的数据处理, 受每轮的时间预算限制, 执行不完的留到下一轮
+    };
+
     // 在当前loop中执行cb
     void RunInLoop(Functor cb);
     // 把cb放入队列中, 唤醒loop所在的线程, 执行cb
-    void QueneInLoop(Functor cb);
+    void QueneInLoop(Functor cb, Priority priority = kUrgent);
+
+    // 每一轮执行kBulk回调的时间预算, 超出后剩下的回调留到下一轮, 期间照常处理IO事件, 0表示不限制
+    // 预算在执行每个回调之前检查, 单个回调本身的耗时不受限制, 只能在loop线程中或者Loop()开始之前调用
+    void SetBulkBudget(int64_t budget_us) { BulkBudgetUs_ = budget_us; }
+    // kBulk回调因超出预算而留到下一轮的次数
+    uint64_t BulkRollovers() const { return BulkRollovers_.load(std::memory_order_relaxed); }
 
     // 唤醒loop所在线程
     void Wakeup();
 
+    // 在计算线程池中执行task, 完成后在当前loop中执行continuation, 可以跨线程调用
+    // 多个任务的continuation会合并投递, 见ComputePool
+    void Offload(Functor task, Functor continuation = Functor());
+    // Offload使用的线程池, 默认是ComputePool::Default(), 需要在Offload之前设置
+    void SetComputePool(ComputePool* pool) { ComputePool_ = pool; }
+    ComputePool* GetComputePool() const;
+
+    // 以该loop为消费者的RingChannel, 每一轮执行完回调之后处理, 只能在loop线程中调用, 见RingChannel
+    void AddRingChannel(const std::shared_ptr<RingChannelBase>& channel);
+    void RemoveRingChannel(const std::shared_ptr<RingChannelBase>& channel); // 先处理完已经入队的消息
+    // 有RingChannel从空闲变为有消息, 可以跨线程调用, 与回调队列共用一次唤醒
+    void WakeupRingChannels();
+
+    // 定时器, 可以跨线程调用, 回调在loop线程中执行
+    TimerId RunAt(TimeStamp time, TimerCallback cb); // 在time时刻执行cb
+    TimerId RunAfter(double delay, TimerCallback cb); // delay秒之后执行cb
+    TimerId RunEvery(double interval, TimerCallback cb); // 每隔interval秒执行一次cb
+    void Cancel(TimerId timerid);
+    // 协程版本(C++20): co_await loop->Sleep(ms), 协程在loop线程中恢复, 协程类型见Coroutine.h
+    SleepAwaiter Sleep(int64_t milliseconds);
+
+    // loop自己的空闲超时时间轮(tick为1秒), 第一次使用时创建, 只能在loop线程中调用
+    TimingWheel* GetTimingWheel();
+
     // EventLoop的方法 ==> Poller的方法
     void UpdateChannel(Channel* channel);
     void RemoveChannel(Channel* channel);
     bool HasChannel(Channel* channel);
 
+    // Poller的interest变更统计: UpdateChannel次数, 以及实际提交给内核的次数
+    uint64_t InterestChanges() const { return poller_->InterestChanges(); }
+    uint64_t InterestOps() const { return poller_->InterestOps(); }
+
+    // loop线程的内存池, 连接对象和缓冲区从这里分配, 见SlabPool
+    SlabPool* GetSlabPool() const { return SlabPool_; }
+    // 把空闲内存还给系统: 内存池只保留SlabPool::kDefaultTrimTarget字节, 再调用malloc_trim
+    // 每秒最多执行一次, 期间的多次调用合并到下一次, 只能在loop线程中调用
+    void TrimMemory();
+
     // 判断EventLoop对象是否在自己的线程里面
     bool IsInLoopThread() const { return ThreadId_ == CurrentThread::Tid(); }
+    // 当前线程的EventLoop, 没有时返回nullptr
+    static EventLoop* LoopOfCurrentThread();
+
+    // 跨线程投递回调时实际写eventfd的次数, 以及被合并掉的唤醒次数(即省下的write系统调用)
+    uint64_t WakeupWrites() const { return WakeupWrites_.load(std::memory_order_relaxed); }
+    uint64_t WakeupsCoalesced() const { return WakeupsCoalesced_.load(std::memory_order_relaxed); }
+
+    // 负载统计, 可以在任意线程中读取, 供EventLoopThreadPool选择loop
+    // 分配到该loop的连接数, 由TcpServer在分配和移除连接时维护
+    void ConnectionAdded() { NumConnections_.fetch_add(1, std::memory_order_relaxed); }
+    void ConnectionRemoved() { NumConnections_.fetch_sub(1, std::memory_order_relaxed); }
+    int NumConnections() const { return NumConnections_.load(std::memory_order_relaxed); }
+    // 绑定在该loop上, 连接关闭之后仍可能被用户持有的对象(TcpConnection, Strand)的数目
+    // 这些对象析构之前GetLoop()都必须有效, 自动伸缩退役的loop等它降到0才析构
+    void Ref() { refs_.fetch_add(1, std::memory_order_relaxed); }
+    void Unref() { refs_.fetch_sub(1, std::memory_order_release); }
+    int RefCount() const { return refs_.load(std::memory_order_acquire); }
+    // 回调队列中等待执行的回调个数(近似值)
+    size_t PendingFunctors() const;
+    // 最近一个统计窗口内处理事件和回调的时间占比, 单位千分之一; loop长时间阻塞在Poll中时为0
+    int BusyPermille() const;
 
 private:
     void HandleRead(); // Wakeup
-    void DoPendingFunctors(); // 执行回调
+    size_t DoPendingFunctors(); // 执行回调, 返回执行的个数
+    size_t DoRingChannels(); // 处理RingChannel中的消息, 返回处理的条数
+    void WakeupForPending(); // 有新回调入队, 合并重复的唤醒
+    int PollTimeoutMs() const; // 根据最近的定时器计算Poller的超时时间
+    void DoTrimMemory(); // 执行TrimMemory合并之后的一次收缩
+    void UpdateBusyTime(); // 一轮结束, 累计这一轮的忙碌时间
 
     using ChannelList = std::vector<Channel*>;
 
@@ -56,7 +146,16 @@ private:
     const pid_t ThreadId_; // 记录当前loop所在的线程id
 
     TimeStamp PollReturnTime_; // Poller返回发生事件的channels的时间点
+    TimeStamp LastActiveTime_; // 最近一次有事件或回调的时间点
+    int64_t BusyPollUs_;
+    int NumaNode_;
+    ComputePool* ComputePool_;
+    SlabPool* SlabPool_; // 析构时Detach, 未释放的块全部释放之后才销毁
+    bool TrimPending_;
+    TimeStamp LastTrimTime_;
     std::unique_ptr<Poller> poller_;
+    std::unique_ptr<TimerQueue> TimerQueue_;
+    std::unique_ptr<TimingWheel> TimingWheel_; // 依赖TimerQueue_驱动, 必须先于它析构
 
     // 主要作用: 当mainloop获取一个新用户的Channel, 通过轮询算法选择一个subloop, 通过该成员唤醒subloop处理Channel
     int WakeupFd_; 
@@ -65,7 +164,44 @@ private:
     ChannelList ActiveChannels_;
 
     std::atomic_bool CallingPendingFunctors_; // 标识当前loop是否有需要执行的回调操作
-    std::vector<Functor> PendingFunctors_; // 存储loop需要执行的所有回调操作
-    
-    std::mutex mutex_; // 互斥锁, 用来保护上面vector容器的线程安全操作
-};
\ No newline at end of file
+    MpscQueue<Functor> PendingFunctors_; // 存储loop需要执行的kUrgent回调, 无锁的多生产者单消费者队列
+    MpscQueue<Functor> BulkFunctors_; // kBulk回调
+    int64_t BulkBudgetUs_;
+    std::atomic<uint64_t> BulkRollovers_;
+
+    std::vector<std::shared_ptr<RingChannelBase>> RingChannels_;
+    std::atomic_bool RingsPending_; // 有RingChannel等待处理
+
+    // 已经写过eventfd, 而loop还没有开始执行回调, 此期间的投递不需要再唤醒
+    std::atomic_bool WakeupPending_;
+    std::atomic<uint64_t> WakeupWrites_;
+    std::atomic<uint64_t> WakeupsCoalesced_;
+
+    std::atomic_int NumConnections_;
+    std::atomic_int refs_;
+    std::atomic<uint64_t> FunctorsQueued_; // 生产者累计入队的回调数
+    std::atomic<uint64_t> FunctorsDone_; // loop累计执行的回调数
+    int64_t BusyUs_; // 当前统计窗口内的忙碌时间
+    TimeStamp BusyWindowStart_;
+    std::atomic_int BusyPermille_;
+    std::atomic<int64_t> BusyUpdatedUs_; // 最近一次发布BusyPermille_的时间
+};
+
+// co_await的等待对象, await_suspend只在C++20的协程中实例化, 见TcpConnection.h中的ReadAwaiter
+class SleepAwaiter
+{
+public:
+    SleepAwaiter(EventLoop* loop, int64_t milliseconds): loop_(loop), milliseconds_(milliseconds) {}
+
+    bool await_ready() const { return false; }
+    template <typename Handle>
+    void await_suspend(Handle handle)
+    {
+        loop_->RunAfter(static_cast<double>(milliseconds_) / 1000, [handle]() { handle.resume(); });
+    }
+    void await_resume() const {}
+
+private:
+    EventLoop* loop_;
+    int64_t milliseconds_;
+};
@@ -1,13 +1,15 @@
 #include "EventLoopThread.h"
 #include "EventLoop.h"
 
-EventLoopThread::EventLoopThread(const ThreadInitCallback& cb, const std::string& name)
+EventLoopThread::EventLoopThread(const ThreadInitCallback& cb, const std::string& name, Poller::Backend backend)
     : loop_(nullptr)
     , exiting_(false)
     , thread_(std::bind(&EventLoopThread::ThreadFunc, this), name)
     , mutex_()
     , cond_()
     , callback_(cb)
+    , backend_(backend)
+    , NumaNode_(-1)
 {}
 
 EventLoopThread::~EventLoopThread()
@@ -20,6 +22,12 @@ EventLoopThread::~EventLoopThread()
     }
 }
 
+void EventLoopThread::SetAffinity(const std::vector<int>& cpus, int numa_node)
+{
+    NumaNode_ = numa_node;
+    thread_.SetAffinity(cpus, numa_node);
+}
+
 EventLoop* EventLoopThread::StartLoop()
 {
     thread_.Start(); // 启动底层的线程
@@ -40,7 +48,8 @@ EventLoop* EventLoopThread::StartLoop()
 // 下面这个方法, 是在单独的新线程里面运行的
 void EventLoopThread::ThreadFunc()
 {
-    EventLoop loop; // 创建一个独立的EventLoop, 和上面的线程是一一对应的, one loop per thread
+    EventLoop loop(backend_); // 创建一个独立的EventLoop, 和上面的线程是一一对应的, one loop per thread
+    loop.SetNumaNode(NumaNode_);
 
     if (callback_)
     {
@@ -4,9 +4,11 @@
 #include <mutex>
 #include <condition_variable>
 #include <string>
+#include <vector>
 
 #include "noncopyable.h"
 #include "Thread.h"
+#include "Poller.h"
 
 class EventLoop;
 
@@ -16,9 +18,13 @@ public:
     using ThreadInitCallback = std::function<void(EventLoop*)>;
 
     EventLoopThread(const ThreadInitCallback& cb = ThreadInitCallback(), 
-                    const std::string& name = std::string());
+                    const std::string& name = std::string(), 
+                    Poller::Backend backend = Poller::kDefaultBackend);
     ~EventLoopThread();
 
+    // 线程绑定的CPU和NUMA节点, 需要在StartLoop之前调用, 见Thread::SetAffinity
+    void SetAffinity(const std::vector<int>& cpus, int numa_node = -1);
+
     EventLoop* StartLoop();
 
 private:
@@ -30,4 +36,6 @@ private:
     std::mutex mutex_;
     std::condition_variable cond_;
     ThreadInitCallback callback_;
+    Poller::Backend backend_; // 新loop使用的IO复用后端
+    int NumaNode_;
 };
\ No newline at end of file
@@ -1,5 +1,14 @@
+#include <arpa/inet.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
 #include "EventLoopThreadPool.h"
 #include "EventLoopThread.h"
+#include "EventLoop.h"
+#include "InetAddress.h"
+#include "Logger.h"
 
 EventLoopThreadPool::EventLoopThreadPool(EventLoop* baseloop, const std::string& name_arg)
     : BaseLoop_(baseloop)
@@ -7,21 +16,53 @@ EventLoopThreadPool::EventLoopThreadPool(EventLoop* baseloop, const std::string&
     , started_(false)
     , NumThread_(0)
     , next_(0)
+    , backend_(Poller::kDefaultBackend)
+    , policy_(kRoundRobin)
+    , AutoScale_(false)
+    , MinThreads_(0)
+    , MaxThreads_(0)
+    , HighBusyPermille_(0)
+    , LowBusyPermille_(0)
+    , ScaleInterval_(0)
+    , ScaleSamples_(0)
+    , HighSamples_(0)
+    , LowSamples_(0)
+    , DrainTimeout_(30.0)
 {}
 
-EventLoopThreadPool::~EventLoopThreadPool() {}
+EventLoopThreadPool::~EventLoopThreadPool()
+{
+    if (AutoScale_ && started_)
+    {
+        BaseLoop_->Cancel(ScaleTimer_);
+    }
+}
+
+void EventLoopThreadPool::SetAutoScale(int min_threads, int max_threads, int high_permille, int low_permille,
+                                       double interval, int samples)
+{
+    AutoScale_ = true;
+    MinThreads_ = std::max(min_threads, 1);
+    MaxThreads_ = std::max(max_threads, MinThreads_);
+    HighBusyPermille_ = high_permille;
+    LowBusyPermille_ = std::min(low_permille, high_permille);
+    ScaleInterval_ = interval;
+    ScaleSamples_ = std::max(samples, 1);
+}
 
 void EventLoopThreadPool::Start(const ThreadInitCallback& cb)
 {
     started_ = true;
+    callback_ = cb;
+
+    if (AutoScale_)
+    {
+        NumThread_ = std::min(std::max(NumThread_, MinThreads_), MaxThreads_);
+    }
 
     for (int i = 0; i < NumThread_; i++)
     {
-        char buf[name_.size() + 32];
-        snprintf(buf, sizeof(buf), "%s%d", name_.c_str(), i);
-        EventLoopThread* t = new EventLoopThread(cb, buf);
-        threads_.push_back(std::unique_ptr<EventLoopThread>(t));
-        loops_.push_back(t->StartLoop()); // 底层创建线程, 绑定一个新的EventLoop, 并返回该loop的地址
+        AddLoop(i);
     }
     
     // 整个服务器只有一个线程, 运行着BaseLoop
@@ -29,6 +70,190 @@ void EventLoopThreadPool::Start(const ThreadInitCallback& cb)
     {
         cb(BaseLoop_);
     }
+
+    if (AutoScale_)
+    {
+        ScaleTimer_ = BaseLoop_->RunEvery(ScaleInterval_, std::bind(&EventLoopThreadPool::AutoScale, this));
+    }
+}
+
+void EventLoopThreadPool::AddLoop(int slot)
+{
+    char buf[name_.size() + 32];
+    snprintf(buf, sizeof(buf), "%s%d", name_.c_str(), slot);
+    EventLoopThread* t = new EventLoopThread(callback_, buf, backend_);
+    if (!cpus_.empty() || !NumaNodes_.empty())
+    {
+        std::vector<int> cpus;
+        if (!cpus_.empty())
+        {
+            cpus.push_back(cpus_[slot % cpus_.size()]);
+        }
+        t->SetAffinity(cpus, NumaNodes_.empty() ? -1 : NumaNodes_[slot % NumaNodes_.size()]);
+    }
+    threads_.push_back(std::unique_ptr<EventLoopThread>(t));
+    loops_.push_back(t->StartLoop()); // 底层创建线程, 绑定一个新的EventLoop, 并返回该loop的地址
+    slots_.push_back(slot);
+}
+
+void EventLoopThreadPool::RetireLoop(size_t index)
+{
+    RetiringLoop retiring;
+    retiring.thread = std::move(threads_[index]);
+    retiring.loop = loops_[index];
+    retiring.slot = slots_[index];
+    retiring.notified = false;
+    retiring.RetireTime = TimeStamp::now();
+    retiring.DrainStage = 0;
+    retiring_.push_back(std::move(retiring));
+
+    threads_.erase(threads_.begin() + index);
+    loops_.erase(loops_.begin() + index);
+    slots_.erase(slots_.begin() + index);
+    if (next_ >= static_cast<int>(loops_.size()))
+    {
+        next_ = 0;
+    }
+}
+
+void EventLoopThreadPool::AutoScale()
+{
+    // 退役的loop上连接都已关闭, 通过它自己的回调队列确认之前投递的回调(比如ConnectDestoryed)都已执行
+    TimeStamp now = TimeStamp::now();
+    for (RetiringLoop& retiring : retiring_)
+    {
+        if (retiring.notified)
+        {
+            continue;
+        }
+        if (retiring.loop->NumConnections() == 0)
+        {
+            // 连接对象还被用户持有时loop不能析构, 继续等待
+            if (retiring.loop->RefCount() == 0)
+            {
+                retiring.notified = true;
+                retiring.loop->QueneInLoop(std::bind(&EventLoopThreadPool::NotifyRetired, this, retiring.loop));
+            }
+        }
+        else if (DrainTimeout_ > 0 && DrainCallback_ && retiring.DrainStage < 2)
+        {
+            // 长连接不会自己关闭, 每超过一个排空时间升级一次: 先Shutdown, 再ForceClose
+            double waited = static_cast<double>(now.MicroSecondsSinceEpoch() - retiring.RetireTime.MicroSecondsSinceEpoch())
+                            / TimeStamp::kMicroSecondsPerSecond;
+            if (waited >= DrainTimeout_ * (retiring.DrainStage + 1))
+            {
+                bool force = retiring.DrainStage == 1;
+                LOG_INFO("EventLoopThreadPool [%s] %s %d connections on retiring loop %p\n", name_.c_str(),
+                         force ? "force closing" : "shutting down", retiring.loop->NumConnections(), retiring.loop);
+                DrainCallback_(retiring.loop, force);
+                ++retiring.DrainStage;
+            }
+        }
+    }
+
+    if (loops_.empty())
+    {
+        return;
+    }
+    int total = 0;
+    for (EventLoop* loop : loops_)
+    {
+        total += loop->BusyPermille();
+    }
+    int busy = total / static_cast<int>(loops_.size());
+
+    if (busy >= HighBusyPermille_)
+    {
+        ++HighSamples_;
+        LowSamples_ = 0;
+    }
+    else if (busy <= LowBusyPermille_)
+    {
+        ++LowSamples_;
+        HighSamples_ = 0;
+    }
+    else
+    {
+        HighSamples_ = 0;
+        LowSamples_ = 0;
+    }
+
+    if (HighSamples_ >= ScaleSamples_ && static_cast<int>(loops_.size()) < MaxThreads_)
+    {
+        HighSamples_ = 0;
+        // 使用最小的空闲slot, 保持线程名和CPU绑定紧凑
+        int slot = 0;
+        bool used = true;
+        while (used)
+        {
+            used = std::find(slots_.begin(), slots_.end(), slot) != slots_.end();
+            for (const RetiringLoop& retiring : retiring_)
+            {
+                used = used || retiring.slot == slot;
+            }
+            if (used)
+            {
+                ++slot;
+            }
+        }
+        AddLoop(slot);
+        EmitScaleEvent(ScaleEvent::kScaleUp, loops_.back(), busy);
+    }
+    else if (LowSamples_ >= ScaleSamples_ && static_cast<int>(loops_.size()) > MinThreads_)
+    {
+        LowSamples_ = 0;
+        // 退役连接最少的loop, 排空得最快
+        size_t index = 0;
+        for (size_t i = 1; i < loops_.size(); i++)
+        {
+            if (loops_[i]->NumConnections() < loops_[index]->NumConnections())
+            {
+                index = i;
+            }
+        }
+        EventLoop* loop = loops_[index];
+        RetireLoop(index);
+        EmitScaleEvent(ScaleEvent::kScaleDown, loop, busy);
+    }
+}
+
+void EventLoopThreadPool::NotifyRetired(EventLoop* loop)
+{
+    BaseLoop_->QueneInLoop(std::bind(&EventLoopThreadPool::FinishRetire, this, loop));
+}
+
+void EventLoopThreadPool::FinishRetire(EventLoop* loop)
+{
+    for (auto it = retiring_.begin(); it != retiring_.end(); ++it)
+    {
+        if (it->loop == loop)
+        {
+            // EventLoopThread析构时退出loop并join线程
+            retiring_.erase(it);
+            EmitScaleEvent(ScaleEvent::kRetired, loop, 0);
+            return;
+        }
+    }
+}
+
+void EventLoopThreadPool::EmitScaleEvent(ScaleEvent::Action action, EventLoop* loop, int busy_permille)
+{
+    static const char* kActionNames[] = {"scale up", "scale down", "retired"};
+
+    ScaleEvent event;
+    event.action = action;
+    event.time = TimeStamp::now();
+    event.loop = loop;
+    event.ActiveLoops = static_cast<int>(loops_.size());
+    event.RetiringLoops = static_cast<int>(retiring_.size());
+    event.AverageBusyPermille = busy_permille;
+
+    LOG_INFO("EventLoopThreadPool [%s] %s: loop %p, active %d, retiring %d, busy %d permille\n",
+             name_.c_str(), kActionNames[action], loop, event.ActiveLoops, event.RetiringLoops, busy_permille);
+    if (ScaleCallback_)
+    {
+        ScaleCallback_(event);
+    }
 }
 
 // 如果工作在多线程中, BaseLoop_默认以轮询的方式分配Channel给subloop
@@ -49,6 +274,76 @@ EventLoop* EventLoopThreadPool::GetNextLoop()
     return loop;
 }
 
+// 负载越小越好: 忙碌时间占比(千分比)和回调队列长度(个数)单位不同, 不相加, 依次比较, 最后看连接数
+static bool LessLoaded(EventLoop* lhs, EventLoop* rhs)
+{
+    int lhs_busy = lhs->BusyPermille();
+    int rhs_busy = rhs->BusyPermille();
+    if (lhs_busy != rhs_busy)
+    {
+        return lhs_busy < rhs_busy;
+    }
+    // 忙碌时间占比按窗口统计, 负载低时常常都是0, 这时回调积压更能反映瞬时的负载
+    size_t lhs_pending = lhs->PendingFunctors();
+    size_t rhs_pending = rhs->PendingFunctors();
+    if (lhs_pending != rhs_pending)
+    {
+        return lhs_pending < rhs_pending;
+    }
+    return lhs->NumConnections() < rhs->NumConnections();
+}
+
+EventLoop* EventLoopThreadPool::GetLoopForPeer(const InetAddress& peer_addr)
+{
+    if (loops_.empty())
+    {
+        return BaseLoop_;
+    }
+    if (PlacementCallback_)
+    {
+        return PlacementCallback_(loops_, peer_addr);
+    }
+
+    switch (policy_)
+    {
+    case kLeastConnections:
+    {
+        EventLoop* loop = loops_[0];
+        for (size_t i = 1; i < loops_.size(); i++)
+        {
+            if (loops_[i]->NumConnections() < loop->NumConnections())
+            {
+                loop = loops_[i];
+            }
+        }
+        return loop;
+    }
+    case kPowerOfTwoChoices:
+    {
+        if (loops_.size() == 1)
+        {
+            return loops_[0];
+        }
+        size_t first = rng_() % loops_.size();
+        size_t second = rng_() % (loops_.size() - 1);
+        if (second >= first)
+        {
+            ++second;
+        }
+        return LessLoaded(loops_[second], loops_[first]) ? loops_[second] : loops_[first];
+    }
+    case kPeerHash:
+    {
+        // 只用IP不用端口, 同一个客户端的多个连接落在同一个loop上
+        // 乘法哈希把地址的各位打散到高32位, 再映射到[0, loops_.size())
+        uint32_t hash = ntohl(peer_addr.GetSockAddr()->sin_addr.s_addr) * 2654435761u;
+        return loops_[(static_cast<uint64_t>(hash) * loops_.size()) >> 32];
+    }
+    default:
+        return GetNextLoop();
+    }
+}
+
 std::vector<EventLoop*> EventLoopThreadPool::GetAllLoops()
 {
     if (loops_.empty())
@@ -59,4 +354,105 @@ std::vector<EventLoop*> EventLoopThreadPool::GetAllLoops()
     {
         return loops_;
     }
-}
\ No newline at end of file
+}
+struct EventLoopThreadPool::Broadcast
+{
+    Broadcast(Functor f, Functor d): fn(std::move(f)), done(std::move(d)), remaining(0) {}
+
+    const Functor fn;
+    const Functor done;
+    std::atomic_int remaining; // 还没有执行fn的loop数
+};
+
+void EventLoopThreadPool::RunInAllLoops(Functor fn, Functor done)
+{
+    std::shared_ptr<Broadcast> broadcast = std::make_shared<Broadcast>(std::move(fn), std::move(done));
+    bool first;
+    {
+        std::lock_guard<std::mutex> lock(BroadcastMutex_);
+        first = PendingBroadcasts_.empty();
+        PendingBroadcasts_.push_back(std::move(broadcast));
+    }
+    // 只有第一个广播负责调度, 在FlushBroadcasts执行之前到来的广播都合并到同一批
+    // 即使在BaseLoop中调用也放入队列, 同一轮回调中的多次广播合并成一批
+    if (first)
+    {
+        BaseLoop_->QueneInLoop(std::bind(&EventLoopThreadPool::FlushBroadcasts, this));
+    }
+}
+
+void EventLoopThreadPool::FlushBroadcasts()
+{
+    std::shared_ptr<BroadcastList> broadcasts = std::make_shared<BroadcastList>();
+    {
+        std::lock_guard<std::mutex> lock(BroadcastMutex_);
+        broadcasts->swap(PendingBroadcasts_);
+    }
+    if (broadcasts->empty())
+    {
+        return;
+    }
+
+    // loop列表只在BaseLoop中变化(自动伸缩), 在这里读取
+    std::vector<EventLoop*> loops = GetAllLoops();
+    for (const RetiringLoop& retiring : retiring_)
+    {
+        // 已经投递了NotifyRetired的loop随时会退出, 退出时不再执行队列中的回调, 广播给它就永远等不到done
+        if (!retiring.notified)
+        {
+            loops.push_back(retiring.loop);
+        }
+    }
+
+    // 先设置好计数再投递, 先执行完的loop不会提前把计数减到0
+    for (const std::shared_ptr<Broadcast>& broadcast : *broadcasts)
+    {
+        broadcast->remaining.store(static_cast<int>(loops.size()), std::memory_order_relaxed);
+    }
+    std::shared_ptr<const BroadcastList> batch(std::move(broadcasts));
+    for (EventLoop* loop : loops)
+    {
+        loop->RunInLoop(std::bind(&EventLoopThreadPool::RunBroadcasts, batch));
+    }
+}
+
+void EventLoopThreadPool::RunBroadcasts(const std::shared_ptr<const BroadcastList>& broadcasts)
+{
+    for (const std::shared_ptr<Broadcast>& broadcast : *broadcasts)
+    {
+        broadcast->fn();
+        if (broadcast->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1 && broadcast->done)
+        {
+            broadcast->done();
+        }
+    }
+}
+
+void EventLoopThreadPool::RunInAllLoopsAndWait(Functor fn)
+{
+    EventLoop* current = EventLoop::LoopOfCurrentThread();
+    if (current != nullptr && current != BaseLoop_)
+    {
+        LOG_FATAL("EventLoopThreadPool::RunInAllLoopsAndWait called in loop thread %p\n", current);
+    }
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool finished = false;
+    RunInAllLoops(std::move(fn), [&]() {
+        std::lock_guard<std::mutex> lock(mutex);
+        finished = true;
+        cond.notify_one();
+    });
+    if (current == BaseLoop_)
+    {
+        // 等待期间BaseLoop不会执行已经排队的FlushBroadcasts, 直接在这里投递
+        FlushBroadcasts();
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!finished)
+    {
+        cond.wait(lock);
+    }
+}
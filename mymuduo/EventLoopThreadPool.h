@@ -4,39 +4,170 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <random>
+#include <mutex>
 
 #include "noncopyable.h"
+#include "Poller.h"
+#include "Timestamp.h"
+#include "TimerId.h"
 
 class EventLoop;
 class EventLoopThread;
+class InetAddress;
 
 class EventLoopThreadPool: noncopyable
 {
 public:
+    using Functor = std::function<void()>;
     using ThreadInitCallback = std::function<void(EventLoop*)>;
+    // 自定义的连接分配策略, 从loops中为peer_addr选择一个loop
+    using PlacementCallback = std::function<EventLoop*(const std::vector<EventLoop*>& loops, const InetAddress& peer_addr)>;
+    // 关闭loop上剩余的连接, force为false时优雅关闭(Shutdown), 否则强制关闭(ForceClose), 在BaseLoop中执行
+    using DrainCallback = std::function<void(EventLoop* loop, bool force)>;
+
+    // 新连接分配到subloop的策略
+    enum PlacementPolicy
+    {
+        kRoundRobin, // 轮询
+        kLeastConnections, // 连接数最少的loop
+        kPowerOfTwoChoices, // 随机选两个loop, 依次比较忙碌时间占比, 回调队列长度, 连接数, 取负载较低的一个
+        kPeerHash, // 按对端IP哈希, 同一个客户端总是落在同一个loop上
+    };
+
+    // 自动伸缩的一次决策, 通过ScaleCallback输出
+    struct ScaleEvent
+    {
+        enum Action
+        {
+            kScaleUp, // 新增了一个loop
+            kScaleDown, // 一个loop开始退役, 不再分配新连接, 等待已有的连接关闭
+            kRetired, // 退役的loop上的连接对象都已析构, 线程已退出
+        };
+        Action action;
+        TimeStamp time;
+        EventLoop* loop; // 新增/退役的loop, kRetired时loop已经析构, 只能用来做标识
+        int ActiveLoops; // 决策之后的活跃loop数
+        int RetiringLoops; // 决策之后正在退役的loop数
+        int AverageBusyPermille; // 做出决策时活跃loop的平均忙碌时间占比
+    };
+    using ScaleCallback = std::function<void(const ScaleEvent&)>;
 
     EventLoopThreadPool(EventLoop* baseloop, const std::string& name_arg);
     ~EventLoopThreadPool();
 
     void SetThreadNum(int num_threads) { NumThread_ = num_threads; }
+    // 设置subloop使用的IO复用后端, 需要在Start之前调用
+    void SetPollerBackend(Poller::Backend backend) { backend_ = backend; }
+
+    // 第i个subloop线程绑定到cpus[i % cpus.size()], 需要在Start之前调用
+    void SetCpuAffinity(const std::vector<int>& cpus) { cpus_ = cpus; }
+    // 第i个subloop线程运行在nodes[i % nodes.size()]上, 内存(包括连接的缓冲区)优先从该节点分配
+    // 同时设置了cpus时按cpus绑定, 否则绑定到该节点的所有CPU上
+    void SetNumaNodes(const std::vector<int>& nodes) { NumaNodes_ = nodes; }
+
+    /*
+    运行时根据subloop的忙碌时间占比自动伸缩, 需要在Start之前调用, 初始线程数为SetThreadNum限制在[min, max]之间
+    每interval秒采样一次活跃loop的平均BusyPermille, 连续samples次高于high_permille时新增一个loop,
+    连续samples次低于low_permille时退役连接数最少的loop; 高低两个阈值之间的间隔和连续采样次数构成滞回,
+    每次决策后重新计数, 避免来回抖动
+    退役的loop不再分配新连接, 连接不会被迁移; 超过排空时间还有连接时先Shutdown, 再过一个排空时间ForceClose
+    连接关闭, 并且绑定在该loop上的TcpConnection/Strand对象都析构之后线程才退出(见EventLoop::Ref),
+    用户直接保存的EventLoop*(定时器, RingChannel等)需要在ScaleCallback收到kScaleDown之后自行清理
+    */
+    void SetAutoScale(int min_threads, int max_threads, int high_permille = 750, int low_permille = 250,
+                      double interval = 1.0, int samples = 3);
+    // 每次伸缩决策的回调, 在BaseLoop中执行
+    void SetScaleCallback(const ScaleCallback& cb) { ScaleCallback_ = cb; }
+    // 退役的loop排空连接的时间, <= 0表示一直等待连接自己关闭
+    void SetRetireDrainTimeout(double seconds) { DrainTimeout_ = seconds; }
+    // 由TcpServer设置, 没有设置时退役的loop只能等待连接自己关闭
+    void SetDrainCallback(const DrainCallback& cb) { DrainCallback_ = cb; }
 
     void Start(const ThreadInitCallback& cb = ThreadInitCallback());
 
+    void SetPlacementPolicy(PlacementPolicy policy) { policy_ = policy; }
+    // 设置之后优先于PlacementPolicy
+    void SetPlacementCallback(const PlacementCallback& cb) { PlacementCallback_ = cb; }
+
     // 如果工作在多线程中, BaseLoop_默认以轮询的方式分配Channel给subloop
     EventLoop* GetNextLoop();
+    // 按分配策略为新连接选择loop, 只能在BaseLoop中调用
+    EventLoop* GetLoopForPeer(const InetAddress& peer_addr);
 
+    // 所有活跃的loop, 不包括正在退役的loop
     std::vector<EventLoop*> GetAllLoops();
 
+    /*
+    在每个loop(包括还没有开始退出的退役loop, 没有subloop时为BaseLoop)中执行一次fn, 可以在任意线程调用
+    fn只保存一份, 各个loop共享, 不会为每个loop复制, 所以fn在多个loop中被并发调用时只能读取捕获的数据
+    广播先在BaseLoop中攒成一批, 每批给每个loop投递一个回调, 同时到来的多次广播每个loop只唤醒一次
+    同一个调用线程的广播在每个loop中按调用顺序执行; done不为空时, 在最后一个执行完fn的loop中执行done
+    */
+    void RunInAllLoops(Functor fn, Functor done = Functor());
+    // 同上, 阻塞到所有loop都执行完fn; 不能在subloop线程中调用, 否则会等待自己而死锁
+    void RunInAllLoopsAndWait(Functor fn);
+
     bool Started() const { return started_; }
 
     const std::string& Name() const { return name_; }
 
 private:
+    // 启动一个新的subloop线程, slot决定线程名以及CPU/NUMA绑定
+    void AddLoop(int slot);
+    void RetireLoop(size_t index);
+    void AutoScale(); // BaseLoop中的定时器回调
+    void NotifyRetired(EventLoop* loop); // 在退役的loop中执行, 它之前的回调都已执行完
+    void FinishRetire(EventLoop* loop);
+    void EmitScaleEvent(ScaleEvent::Action action, EventLoop* loop, int busy_permille);
+
+    struct Broadcast; // 一次广播, 所有loop共享
+    using BroadcastList = std::vector<std::shared_ptr<Broadcast>>;
+    void FlushBroadcasts(); // 在BaseLoop中取出攒下的广播, 给每个loop投递一个回调
+    static void RunBroadcasts(const std::shared_ptr<const BroadcastList>& broadcasts);
+
     EventLoop* BaseLoop_;
     std::string name_;
     bool started_;
     int NumThread_;
     int next_;
+    Poller::Backend backend_;
+    PlacementPolicy policy_;
+    PlacementCallback PlacementCallback_;
+    std::minstd_rand rng_; // kPowerOfTwoChoices使用
+    std::vector<int> cpus_;
+    std::vector<int> NumaNodes_;
+    ThreadInitCallback callback_; // 运行时新增的loop也要执行
     std::vector<std::unique_ptr<EventLoopThread>>threads_;
     std::vector<EventLoop*> loops_;
+    std::vector<int> slots_; // 与loops_一一对应
+
+    // 正在退役的loop
+    struct RetiringLoop
+    {
+        std::unique_ptr<EventLoopThread> thread;
+        EventLoop* loop;
+        int slot;
+        bool notified; // 已经投递了NotifyRetired
+        TimeStamp RetireTime;
+        int DrainStage; // 0: 等待连接关闭, 1: 已经Shutdown, 2: 已经ForceClose
+    };
+    std::vector<RetiringLoop> retiring_;
+
+    bool AutoScale_;
+    int MinThreads_;
+    int MaxThreads_;
+    int HighBusyPermille_;
+    int LowBusyPermille_;
+    double ScaleInterval_;
+    int ScaleSamples_;
+    int HighSamples_; // 连续高于阈值的采样次数
+    int LowSamples_;
+    TimerId ScaleTimer_;
+    ScaleCallback ScaleCallback_;
+    double DrainTimeout_;
+    DrainCallback DrainCallback_;
+
+    std::mutex BroadcastMutex_;
+    BroadcastList PendingBroadcasts_; // 还没有投递给loop的广播
 };
\ No newline at end of file
@@ -0,0 +1,348 @@
+#include <errno.h>
+#include <algorithm>
+#include <unistd.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/epoll.h>
+
+#include "IoUringPoller.h"
+#include "Logger.h"
+#include "Channel.h"
+
+// Channel未添加到Poller中
+const int kNew = -1; // Channel的成员index_= -1
+// Channel已添加到Poller中
+const int kAdded = 1;
+
+// POLL_REMOVE等内部请求的完成事件使用的user_data, 不对应任何Channel
+const uint64_t kInternalUserData = 0;
+
+static int IoUringSetup(unsigned entries, io_uring_params* params)
+{
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+static int IoUringEnter(int ringfd, unsigned to_submit, unsigned min_complete, unsigned flags, void* arg, size_t argsz)
+{
+    return static_cast<int>(syscall(__NR_io_uring_enter, ringfd, to_submit, min_complete, flags, arg, argsz));
+}
+
+bool IoUringPoller::Available()
+{
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = IoUringSetup(4, &params);
+    if (fd < 0)
+    {
+        return false;
+    }
+    close(fd);
+    return (params.features & IORING_FEAT_EXT_ARG) != 0;
+}
+
+IoUringPoller::IoUringPoller(EventLoop* loop)
+    : Poller(loop)
+    , ringfd_(-1)
+    , SqRing_(nullptr)
+    , SqRingSize_(0)
+    , SqeTail_(0)
+    , CqRing_(nullptr)
+    , CqRingSize_(0)
+    , NextSeq_(0)
+{
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ringfd_ = IoUringSetup(kRingEntries, &params);
+    if (ringfd_ < 0)
+    {
+        LOG_FATAL("io_uring_setup error: %d\n", errno);
+    }
+
+    SqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    CqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap)
+    {
+        SqRingSize_ = CqRingSize_ = std::max(SqRingSize_, CqRingSize_);
+    }
+
+    SqRing_ = mmap(nullptr, SqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringfd_, IORING_OFF_SQ_RING);
+    if (SqRing_ == MAP_FAILED)
+    {
+        LOG_FATAL("io_uring mmap sq ring error: %d\n", errno);
+    }
+    if (single_mmap)
+    {
+        CqRing_ = SqRing_;
+    }
+    else
+    {
+        CqRing_ = mmap(nullptr, CqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringfd_, IORING_OFF_CQ_RING);
+        if (CqRing_ == MAP_FAILED)
+        {
+            LOG_FATAL("io_uring mmap cq ring error: %d\n", errno);
+        }
+    }
+    sqes_ = static_cast<io_uring_sqe*>(mmap(nullptr, params.sq_entries * sizeof(io_uring_sqe),
+                                            PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringfd_, IORING_OFF_SQES));
+    if (sqes_ == MAP_FAILED)
+    {
+        LOG_FATAL("io_uring mmap sqes error: %d\n", errno);
+    }
+
+    char* sq = static_cast<char*>(SqRing_);
+    SqHead_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    SqTail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    SqMask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    SqEntries_ = params.sq_entries;
+    SqeTail_ = *SqTail_;
+    // SQ的索引数组与SQE数组一一对应, 之后只需要推进tail
+    unsigned* array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    for (unsigned i = 0; i < SqEntries_; i++)
+    {
+        array[i] = i;
+    }
+
+    char* cq = static_cast<char*>(CqRing_);
+    CqHead_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    CqTail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    CqMask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+}
+
+IoUringPoller::~IoUringPoller()
+{
+    munmap(sqes_, SqEntries_ * sizeof(io_uring_sqe));
+    if (CqRing_ != SqRing_)
+    {
+        munmap(CqRing_, CqRingSize_);
+    }
+    munmap(SqRing_, SqRingSize_);
+    close(ringfd_);
+}
+
+TimeStamp IoUringPoller::Poll(int timeout_ms, ChannelList* active_channels) // io_uring_enter
+{
+    LOG_DEBUG("func = %s ==> fd total count: %lu\n", __FUNCTION__, channels_.size());
+
+    FlushDirtyEntries();
+
+    // 提交所有积攒的interest变化, 同时等待至少一个完成事件
+    int ret = Enter(timeout_ms == 0 ? 0 : 1, timeout_ms);
+
+    int saved_errno = errno;
+    TimeStamp now(TimeStamp::now());
+
+    if (ret < 0 && saved_errno != ETIME && saved_errno != EINTR)
+    {
+        errno = saved_errno;
+        LOG_ERROR("IoUringPoller::Poll error!\n");
+    }
+
+    // 无论enter返回什么, CQ中已经到达的完成事件都一次性收割
+    FillActiveChannels(active_channels);
+
+    return now;
+}
+
+void IoUringPoller::UpdateChannel(Channel* channel)
+{
+    const int index = channel->Index();
+    const int fd = channel->Fd();
+    LOG_DEBUG("func = %s ==> fd = %d, events = %d, index = %d\n", __FUNCTION__, fd, channel->Events(), index);
+    ++InterestChanges_;
+
+    if (index == kNew)
+    {
+        channels_.Insert(fd, channel);
+        if (entries_.size() < channels_.capacity())
+        {
+            entries_.resize(channels_.capacity(), PollEntry());
+        }
+        PollEntry& entry = entries_[fd];
+        entry.channel = channel;
+        entry.UserData = kInternalUserData;
+        entry.armed = false;
+        entry.dirty = false;
+        channel->SetIndex(kAdded);
+    }
+
+    MarkDirty(&entries_[fd], fd);
+}
+
+// 从Poller中删除Channel
+void IoUringPoller::RemoveChannel(Channel* channel)
+{
+    int fd = channel->Fd();
+    channels_.Erase(fd);
+
+    LOG_DEBUG("func = %s ==> fd = %d\n", __FUNCTION__, fd);
+
+    PollEntry* entry = FindEntry(fd);
+    if (entry != nullptr)
+    {
+        if (entry->armed)
+        {
+            PrepPollRemove(entry->UserData);
+        }
+        *entry = PollEntry();
+    }
+    channel->SetIndex(kNew);
+}
+
+IoUringPoller::PollEntry* IoUringPoller::FindEntry(int fd)
+{
+    if (fd < 0 || static_cast<size_t>(fd) >= entries_.size() || entries_[fd].channel == nullptr)
+    {
+        return nullptr;
+    }
+    return &entries_[fd];
+}
+
+void IoUringPoller::MarkDirty(PollEntry* entry, int fd)
+{
+    if (!entry->dirty)
+    {
+        entry->dirty = true;
+        DirtyFds_.push_back(fd);
+    }
+}
+
+void IoUringPoller::FlushDirtyEntries()
+{
+    for (int fd : DirtyFds_)
+    {
+        PollEntry* found = FindEntry(fd);
+        if (found == nullptr || !found->dirty)
+        {
+            continue; // 已经被删除, 或者是删除后重新注册时重复加入的fd
+        }
+
+        PollEntry& entry = *found;
+        entry.dirty = false;
+        if (entry.armed)
+        {
+            PrepPollRemove(entry.UserData);
+            entry.armed = false;
+        }
+
+        if (!entry.channel->IsNoneEvent())
+        {
+            // 每次挂上新的POLL_ADD都使用新的序号, 被撤销请求的完成事件就能被识别出来
+            if (++NextSeq_ == 0)
+            {
+                ++NextSeq_;
+            }
+            entry.UserData = (static_cast<uint64_t>(NextSeq_) << 32) | static_cast<uint32_t>(fd);
+            entry.armed = true;
+            // one-shot请求每次触发后都会重新挂上, EPOLLET对POLL_ADD没有意义
+            PrepPollAdd(fd, entry.channel->Events() & ~EPOLLET, entry.UserData);
+        }
+    }
+    DirtyFds_.clear();
+}
+
+void IoUringPoller::FillActiveChannels(ChannelList* active_channels)
+{
+    unsigned head = *CqHead_;
+    unsigned tail = __atomic_load_n(CqTail_, __ATOMIC_ACQUIRE);
+
+    for (; head != tail; head++)
+    {
+        const io_uring_cqe& cqe = cqes_[head & CqMask_];
+        if (cqe.user_data == kInternalUserData)
+        {
+            continue;
+        }
+
+        int fd = static_cast<int>(cqe.user_data & 0xffffffff);
+        PollEntry* found = FindEntry(fd);
+        if (found == nullptr || found->UserData != cqe.user_data || !found->armed)
+        {
+            continue; // 已经被撤销的POLL_ADD请求
+        }
+
+        PollEntry& entry = *found;
+        entry.armed = false;
+        // one-shot请求已经触发, 下一次Poll前重新挂上, 保持LT语义
+        MarkDirty(&entry, fd);
+        int revents = cqe.res;
+        if (cqe.res < 0)
+        {
+            LOG_ERROR("IoUringPoller poll fd = %d error: %d\n", fd, -cqe.res);
+            if (cqe.res == -EINTR || cqe.res == -EAGAIN || cqe.res == -ENOMEM)
+            {
+                continue; // 暂时性的错误, 只重新挂上
+            }
+            // 其他错误交给Channel, 由HandleError/HandleClose处理, 否则连接不会再收到任何事件
+            revents = EPOLLERR | EPOLLHUP;
+        }
+
+        entry.channel->SetRevents(revents);
+        active_channels->push_back(entry.channel);
+    }
+
+    __atomic_store_n(CqHead_, tail, __ATOMIC_RELEASE);
+}
+
+io_uring_sqe* IoUringPoller::GetSqe()
+{
+    // SQ已满, 先把已有的请求提交给内核
+    if (SqeTail_ - __atomic_load_n(SqHead_, __ATOMIC_ACQUIRE) >= SqEntries_)
+    {
+        Enter(0, 0);
+    }
+
+    io_uring_sqe* sqe = &sqes_[SqeTail_ & SqMask_];
+    memset(sqe, 0, sizeof(*sqe));
+    SqeTail_++;
+    return sqe;
+}
+
+void IoUringPoller::PrepPollAdd(int fd, unsigned events, uint64_t user_data)
+{
+    ++InterestOps_;
+    io_uring_sqe* sqe = GetSqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = events;
+    sqe->user_data = user_data;
+}
+
+void IoUringPoller::PrepPollRemove(uint64_t user_data)
+{
+    ++InterestOps_;
+    io_uring_sqe* sqe = GetSqe();
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = user_data;
+    sqe->user_data = kInternalUserData;
+}
+
+int IoUringPoller::Enter(unsigned min_complete, int timeout_ms)
+{
+    __atomic_store_n(SqTail_, SqeTail_, __ATOMIC_RELEASE);
+    unsigned to_submit = SqeTail_ - __atomic_load_n(SqHead_, __ATOMIC_ACQUIRE);
+
+    unsigned flags = IORING_ENTER_EXT_ARG;
+    __kernel_timespec ts;
+    io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    if (min_complete > 0)
+    {
+        flags |= IORING_ENTER_GETEVENTS;
+        if (timeout_ms >= 0)
+        {
+            ts.tv_sec = timeout_ms / 1000;
+            ts.tv_nsec = (timeout_ms % 1000) * 1000000LL;
+            arg.ts = reinterpret_cast<uint64_t>(&ts);
+        }
+    }
+    else if (to_submit == 0)
+    {
+        return 0;
+    }
+
+    return IoUringEnter(ringfd_, to_submit, min_complete, flags, &arg, sizeof(arg));
+}
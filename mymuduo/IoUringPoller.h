@@ -0,0 +1,77 @@
+#pragma once
+
+#include <vector>
+#include <linux/io_uring.h>
+
+#include "Poller.h"
+
+/*
+基于io_uring的Poller实现, 仍然是readiness模型, 与Channel的使用方式完全一致
+每个Channel对应一个one-shot的IORING_OP_POLL_ADD请求, 触发后在下一次Poll前重新挂上, 保持LT语义
+UpdateChannel/RemoveChannel只是往SQ中追加请求, 真正提交和等待在Poll中合并成一次io_uring_enter
+*/
+class IoUringPoller: public Poller
+{
+public:
+    IoUringPoller(EventLoop* loop); // io_uring_setup
+    ~IoUringPoller() override;
+
+    // 重写基类Poller的抽象方法
+    TimeStamp Poll(int timeout_ms, ChannelList* active_channels) override; // io_uring_enter
+    void UpdateChannel(Channel* channel) override; // IORING_OP_POLL_ADD/POLL_REMOVE
+    void RemoveChannel(Channel* channel) override; // IORING_OP_POLL_REMOVE
+
+    // 探测当前内核是否支持io_uring以及IORING_FEAT_EXT_ARG(带超时的等待)
+    static bool Available();
+
+private:
+    static const unsigned kRingEntries = 1024;
+
+    // fd在io_uring中的注册状态
+    struct PollEntry
+    {
+        Channel* channel; // 空槽为nullptr
+        uint64_t UserData; // 当前挂起的POLL_ADD请求的标识, 用来过滤已经被撤销的请求的完成事件
+        bool armed; // 是否有挂起的POLL_ADD请求
+        bool dirty; // 是否需要在下一次Poll前重新提交
+    };
+
+    // 按fd查找已注册的PollEntry, 不存在时返回nullptr
+    PollEntry* FindEntry(int fd);
+    void MarkDirty(PollEntry* entry, int fd);
+    // 把所有dirty的fd转化为SQE
+    void FlushDirtyEntries();
+    // 填写活跃的连接
+    void FillActiveChannels(ChannelList* active_channels);
+
+    io_uring_sqe* GetSqe();
+    void PrepPollAdd(int fd, unsigned events, uint64_t user_data);
+    void PrepPollRemove(uint64_t user_data);
+    // 提交SQ中尚未被内核消费的请求, 并按需等待完成事件
+    int Enter(unsigned min_complete, int timeout_ms);
+
+    int ringfd_;
+
+    // SQ ring
+    void* SqRing_;
+    size_t SqRingSize_;
+    unsigned* SqHead_;
+    unsigned* SqTail_;
+    unsigned SqMask_;
+    unsigned SqEntries_;
+    io_uring_sqe* sqes_;
+    unsigned SqeTail_; // 本地的SQ尾部, 提交时发布给内核
+
+    // CQ ring
+    void* CqRing_;
+    size_t CqRingSize_;
+    unsigned* CqHead_;
+    unsigned* CqTail_;
+    unsigned CqMask_;
+    io_uring_cqe* cqes_;
+
+    uint32_t NextSeq_;
+    // 以fd为下标, 与channels_同步按2倍增长
+    std::vector<PollEntry> entries_;
+    std::vector<int> DirtyFds_;
+};
@@ -0,0 +1,60 @@
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "MirrorRing.h"
+#include "Logger.h"
+
+size_t MirrorRing::RoundUp(size_t size)
+{
+    static const size_t kPageSize = sysconf(_SC_PAGESIZE);
+    if (size == 0)
+    {
+        return kPageSize;
+    }
+    return (size + kPageSize - 1) / kPageSize * kPageSize;
+}
+
+MirrorRing* MirrorRing::Create(size_t size)
+{
+    size = RoundUp(size);
+    int fd = memfd_create("mymuduo-ring", MFD_CLOEXEC);
+    if (fd < 0)
+    {
+        LOG_ERROR("MirrorRing::Create memfd_create error: %d\n", errno);
+        return nullptr;
+    }
+    if (ftruncate(fd, size) < 0)
+    {
+        LOG_ERROR("MirrorRing::Create ftruncate error: %d\n", errno);
+        close(fd);
+        return nullptr;
+    }
+
+    // 先保留2倍大小的连续地址空间, 再把memfd固定映射到前后两半
+    char* base = static_cast<char*>(mmap(nullptr, 2 * size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    if (base == MAP_FAILED)
+    {
+        LOG_ERROR("MirrorRing::Create reserve error: %d\n", errno);
+        close(fd);
+        return nullptr;
+    }
+    for (int i = 0; i < 2; i++)
+    {
+        void* addr = mmap(base + i * size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+        if (addr == MAP_FAILED)
+        {
+            LOG_ERROR("MirrorRing::Create mmap error: %d\n", errno);
+            munmap(base, 2 * size);
+            close(fd);
+            return nullptr;
+        }
+    }
+    close(fd); // 映射持有memfd的引用, 不需要保留fd
+    return new MirrorRing(base, size);
+}
+
+MirrorRing::~MirrorRing()
+{
+    munmap(base_, 2 * size_);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "noncopyable.h"
+
+/*                         MirrorRing
+        第一次映射                      第二次映射(同一组物理页)
++-------------------------------+-------------------------------+
+|   ...   |  readable  | ...    |   ...   |                     |
++-------------------------------+-------------------------------+
+^ Base()  ^ 读位置      ^ 写位置  ^ Base() + Size()
+                       (超过Size()的部分落在第二次映射中, 就是环的开头)
+
+同一块共享内存(memfd)在虚拟地址空间中背靠背映射两次, 读写位置绕回环首时地址仍然是连续的
+环中任意一段不超过Size()的数据都可以用一个指针访问, 不需要搬移数据
+Size()总是页大小的整数倍; 创建和销毁各需要几次系统调用, 只适合长期存在的连接缓冲区
+*/
+class MirrorRing: noncopyable
+{
+public:
+    // 创建至少size字节的环, 失败时返回nullptr
+    static MirrorRing* Create(size_t size);
+    ~MirrorRing();
+
+    char* Base() const { return base_; }
+    size_t Size() const { return size_; }
+
+    // 向上取整到页大小的整数倍
+    static size_t RoundUp(size_t size);
+
+private:
+    MirrorRing(char* base, size_t size)
+        : base_(base)
+        , size_(size)
+    {}
+
+    char* base_;
+    size_t size_;
+};
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <utility>
+
+#include "noncopyable.h"
+
+/*
+无锁的多生产者单消费者队列(Vyukov MPSC), 用于跨线程向EventLoop投递回调
+生产者只对head_做一次原子交换, 消费者独占tail_, 两者放在不同的cache line上, 避免伪共享
+生产者在交换head_和链接next之间被抢占时, 消费者会暂时看不到后面的元素,
+生产者链接完成后总会唤醒loop, 这些元素在下一轮被执行
+*/
+template <typename T>
+class MpscQueue: noncopyable
+{
+public:
+    MpscQueue()
+        : head_(new Node())
+        , tail_(head_.load(std::memory_order_relaxed))
+    {}
+
+    ~MpscQueue()
+    {
+        T value;
+        while (Pop(&value)) {}
+        delete tail_;
+    }
+
+    // 任意线程调用
+    void Push(T value)
+    {
+        Node* node = new Node(std::move(value));
+        Node* prev = head_.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    // 只能在消费者线程调用
+    bool Pop(T* value)
+    {
+        Node* tail = tail_;
+        Node* next = tail->next.load(std::memory_order_acquire);
+        if (next == nullptr)
+        {
+            return false;
+        }
+
+        *value = std::move(next->value);
+        tail_ = next; // next成为新的哑节点
+        delete tail;
+        return true;
+    }
+
+    // 只能在消费者线程调用, 处理调用时刻已经入队的元素, 处理期间新入队的元素留到下一次
+    template <typename Func>
+    size_t ConsumeAll(Func&& func)
+    {
+        return ConsumeWhile(std::forward<Func>(func), []() { return true; });
+    }
+
+    // 同ConsumeAll, 但每处理一个元素之前先询问more(), 返回false时停止, 剩下的元素留在队列中
+    template <typename Func, typename Pred>
+    size_t ConsumeWhile(Func&& func, Pred&& more)
+    {
+        Node* last = head_.load(std::memory_order_acquire);
+        size_t count = 0;
+        while (tail_ != last && more())
+        {
+            Node* tail = tail_;
+            Node* next = tail->next.load(std::memory_order_acquire);
+            if (next == nullptr)
+            {
+                break; // 生产者还没有完成链接
+            }
+
+            T value(std::move(next->value));
+            tail_ = next;
+            delete tail;
+            func(value);
+            ++count;
+        }
+        return count;
+    }
+
+    // 只能在消费者线程调用
+    bool Empty() const { return tail_->next.load(std::memory_order_acquire) == nullptr; }
+
+private:
+    struct Node
+    {
+        Node(): next(nullptr) {}
+        explicit Node(T v): next(nullptr), value(std::move(v)) {}
+
+        std::atomic<Node*> next;
+        T value;
+    };
+
+    static const int kCacheLineSize = 64;
+
+    // 用整条cache line的填充隔开两端, 不用alignas: C++11的new不保证超过16字节的对齐(Strand等对象在堆上)
+    // 前后也各填充一条, 整个对象不会和相邻的成员共享cache line
+    char pad0_[kCacheLineSize];
+    std::atomic<Node*> head_; // 生产者竞争的入队端
+    char pad1_[kCacheLineSize];
+    Node* tail_; // 消费者独占的出队端
+    char pad2_[kCacheLineSize];
+};
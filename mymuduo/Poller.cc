@@ -2,11 +2,12 @@
 #include "Channel.h"
 
 Poller::Poller(EventLoop* loop)
-    : ownerloop_(loop)
+    : InterestChanges_(0)
+    , InterestOps_(0)
+    , ownerloop_(loop)
 {}
 
 bool Poller::HasChannel(Channel* channel) const
 {
-    auto it = channels_.find(channel->Fd());
-    return it != channels_.end() && it->second == channel;
+    return channels_.Find(channel->Fd()) == channel;
 }
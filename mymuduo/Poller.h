@@ -1,10 +1,10 @@
 #pragma once
 
 #include <vector>
-#include <unordered_map>
 
 #include "noncopyable.h"
 #include "Timestamp.h"
+#include "ChannelTable.h"
 
 class Channel;
 class EventLoop;
@@ -15,6 +15,14 @@ class Poller: noncopyable
 public:
     using ChannelList = std::vector<Channel*>;
 
+    // 可选的IO复用后端, kDefaultBackend根据环境变量选择
+    enum Backend
+    {
+        kDefaultBackend,
+        kEpollBackend,
+        kIoUringBackend,
+    };
+
     Poller(EventLoop* loop);
     virtual ~Poller() = default;
 
@@ -26,13 +34,19 @@ public:
     // 判断参数Channel是否在当前Poller当中
     bool HasChannel(Channel* channel) const;
 
+    // UpdateChannel被调用的次数, 以及真正提交给内核的interest变更次数(epoll_ctl/SQE)
+    uint64_t InterestChanges() const { return InterestChanges_; }
+    uint64_t InterestOps() const { return InterestOps_; }
+
     // EventLoop可以通过该接口获取默认的IO复用的具体实现
-    static Poller* NewDefaultPoller(EventLoop* loop);
+    static Poller* NewDefaultPoller(EventLoop* loop, Backend backend = kDefaultBackend);
 
 protected:
-    // map的key: sockfd  value: sockfd所属的Channel通道类型
-    using ChannelMap = std::unordered_map<int, Channel*>;
-    ChannelMap channels_;
+    // 下标: sockfd  值: sockfd所属的Channel通道类型
+    ChannelTable channels_;
+
+    uint64_t InterestChanges_;
+    uint64_t InterestOps_;
 
 private:
     EventLoop* ownerloop_; // 定义Poller所属的事件循环EventLoop
@@ -0,0 +1,61 @@
+#include "RingChannel.h"
+
+RingChannelBase::RingChannelBase(EventLoop* producer, EventLoop* consumer)
+    : producer_(producer)
+    , consumer_(consumer)
+    , pending_(false)
+    , blocked_(false)
+{}
+
+RingChannelBase::~RingChannelBase() {}
+
+void RingChannelBase::Close()
+{
+    consumer_->QueneInLoop(std::bind(&EventLoop::RemoveRingChannel, consumer_, shared_from_this()));
+}
+
+/*
+生产者先入队再检查pending_, 消费者先清除pending_再出队, 中间都有完整的内存屏障
+所以要么消费者这次能看到新消息, 要么生产者看到pending_已被清除, 重新通知
+*/
+void RingChannelBase::Notify()
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!pending_.load(std::memory_order_relaxed) && !pending_.exchange(true))
+    {
+        consumer_->WakeupRingChannels();
+    }
+}
+
+bool RingChannelBase::Drain(size_t* handled)
+{
+    if (!pending_.load(std::memory_order_relaxed))
+    {
+        *handled = 0;
+        return false;
+    }
+    pending_.store(false);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    *handled = DrainMessages(Capacity());
+    // 取出了消息, 生产者可能在等空间
+    if (*handled > 0 && blocked_.load() && blocked_.exchange(false))
+    {
+        producer_->QueneInLoop(std::bind(&RingChannelBase::RunWritableCallback, shared_from_this()));
+    }
+    if (!Empty())
+    {
+        // 一轮最多处理一个队列容量, 剩下的留到下一轮, 不让一个通道独占loop
+        pending_.store(true);
+        return true;
+    }
+    return false;
+}
+
+void RingChannelBase::RunWritableCallback(const std::shared_ptr<RingChannelBase>& channel)
+{
+    if (channel->WritableCallback_)
+    {
+        channel->WritableCallback_();
+    }
+}
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <atomic>
+#include <vector>
+
+#include "noncopyable.h"
+#include "SpscRing.h"
+#include "EventLoop.h"
+
+/*
+两个loop之间的有界消息通道: 生产者loop写入, 消费者loop在每一轮执行完回调之后批量取出并处理
+消息存放在预先分配好的SpscRing中, 发送不分配内存, 也不构造std::function
+从空闲变为有消息时才通知消费者loop, 一批消息只唤醒一次, 唤醒与回调队列的唤醒合并
+队列满时TrySend返回false(背压), 消费者腾出空间后在生产者loop中执行WritableCallback
+*/
+class RingChannelBase: noncopyable, public std::enable_shared_from_this<RingChannelBase>
+{
+public:
+    using WritableCallback = std::function<void()>;
+
+    RingChannelBase(EventLoop* producer, EventLoop* consumer);
+    virtual ~RingChannelBase();
+
+    EventLoop* ProducerLoop() const { return producer_; }
+    EventLoop* ConsumerLoop() const { return consumer_; }
+
+    // TrySend失败之后, 队列重新有空间时在生产者loop中执行, 偶尔可能多执行一次
+    void SetWritableCallback(WritableCallback cb) { WritableCallback_ = std::move(cb); }
+
+    // 从消费者loop中注销, 之前已经发送的消息处理完之后不再处理新消息, 可以在任意线程调用
+    void Close();
+
+    // 由消费者loop调用, 最多处理一个队列容量的消息, 还有剩余时返回true
+    bool Drain(size_t* handled);
+
+protected:
+    // 消息已经入队, 从空闲变为有消息时通知消费者loop
+    void Notify();
+    // 队列已满, 消费者取出消息之后需要通知生产者
+    void MarkBlocked() { blocked_.store(true); }
+
+    // 处理最多max条消息, 返回处理的条数
+    virtual size_t DrainMessages(size_t max) = 0;
+    virtual size_t Capacity() const = 0;
+    virtual bool Empty() const = 0;
+
+private:
+    static void RunWritableCallback(const std::shared_ptr<RingChannelBase>& channel);
+
+    EventLoop* producer_;
+    EventLoop* consumer_;
+    std::atomic_bool pending_; // 已经通知过消费者loop, 还没有开始处理
+    std::atomic_bool blocked_; // 生产者遇到过队列满
+    WritableCallback WritableCallback_;
+};
+
+template <typename T>
+class RingChannel: public RingChannelBase
+{
+public:
+    using Handler = std::function<void(T& message)>;
+
+    // 创建通道并注册到消费者loop, handler在消费者loop中逐条处理消息
+    static std::shared_ptr<RingChannel> Create(EventLoop* producer, EventLoop* consumer, size_t capacity,
+                                               Handler handler)
+    {
+        std::shared_ptr<RingChannel> channel(new RingChannel(producer, consumer, capacity, std::move(handler)));
+        consumer->RunInLoop(std::bind(&EventLoop::AddRingChannel, consumer,
+                                      std::shared_ptr<RingChannelBase>(channel)));
+        return channel;
+    }
+
+    // 只能在生产者loop中调用; 队列满时返回false, message保持不变, 由调用方决定暂存还是丢弃
+    bool TrySend(T& message)
+    {
+        if (!ring_.TryPush(message))
+        {
+            // 先标记再重试, 消费者要么看到标记, 要么已经腾出了空间让重试成功
+            MarkBlocked();
+            if (!ring_.TryPush(message))
+            {
+                return false;
+            }
+        }
+        Notify();
+        return true;
+    }
+
+    size_t Size() const { return ring_.Size(); }
+
+private:
+    RingChannel(EventLoop* producer, EventLoop* consumer, size_t capacity, Handler handler)
+        : RingChannelBase(producer, consumer)
+        , ring_(capacity)
+        , handler_(std::move(handler))
+    {}
+
+    size_t DrainMessages(size_t max) override
+    {
+        size_t count = 0;
+        while (count < max && ring_.TryPop(&message_))
+        {
+            handler_(message_);
+            ++count;
+        }
+        return count;
+    }
+    size_t Capacity() const override { return ring_.Capacity(); }
+    bool Empty() const override { return ring_.Size() == 0; }
+
+    SpscRing<T> ring_;
+    Handler handler_;
+    T message_; // 出队的消息移动到这里再交给handler, 避免每条消息构造一个临时对象
+};
+
+/*
+一组loop两两之间的通道, 每一对(生产者, 消费者)一个RingChannel, 自己发给自己也走通道
+loop集合在构造时确定, 不会跟随EventLoopThreadPool的自动伸缩变化
+*/
+template <typename T>
+class RingChannelMesh: noncopyable
+{
+public:
+    using Handler = std::function<void(EventLoop* loop, T& message)>;
+
+    RingChannelMesh(const std::vector<EventLoop*>& loops, size_t capacity, Handler handler)
+        : loops_(loops)
+    {
+        for (EventLoop* from : loops_)
+        {
+            for (EventLoop* to : loops_)
+            {
+                channels_.push_back(RingChannel<T>::Create(from, to, capacity,
+                    std::bind(handler, to, std::placeholders::_1)));
+            }
+        }
+    }
+
+    ~RingChannelMesh()
+    {
+        for (auto& channel : channels_)
+        {
+            channel->Close();
+        }
+    }
+
+    const std::vector<EventLoop*>& Loops() const { return loops_; }
+
+    // from发给to的通道, 不属于这组loop时返回nullptr
+    RingChannel<T>* Get(EventLoop* from, EventLoop* to) const
+    {
+        int i = IndexOf(from);
+        int j = IndexOf(to);
+        if (i < 0 || j < 0)
+        {
+            return nullptr;
+        }
+        return channels_[i * loops_.size() + j].get();
+    }
+
+    // 在当前loop中调用, 发给to, 见RingChannel::TrySend
+    bool TrySend(EventLoop* to, T& message)
+    {
+        RingChannel<T>* channel = Get(EventLoop::LoopOfCurrentThread(), to);
+        return channel != nullptr && channel->TrySend(message);
+    }
+
+private:
+    int IndexOf(EventLoop* loop) const
+    {
+        for (size_t i = 0; i < loops_.size(); i++)
+        {
+            if (loops_[i] == loop)
+            {
+                return static_cast<int>(i);
+            }
+        }
+        return -1;
+    }
+
+    std::vector<EventLoop*> loops_;
+    std::vector<std::shared_ptr<RingChannel<T>>> channels_; // channels_[from * n + to]
+};
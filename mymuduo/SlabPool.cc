@@ -0,0 +1,268 @@
+#include <new>
+#include <sys/mman.h>
+
+#include "SlabPool.h"
+
+static_assert(sizeof(void*) * 2 == SlabPool::kHeaderSize, "SlabPool block header must be 16 bytes");
+
+// 当前线程EventLoop的内存池, 库总是随程序一起加载, 可以用initial-exec模型省掉__tls_get_addr调用
+static __thread SlabPool* t_CurrentPool __attribute__((tls_model("initial-exec"))) = nullptr;
+
+SlabPool::BlockHeader* const SlabPool::kClosed = reinterpret_cast<SlabPool::BlockHeader*>(1);
+
+// 只由一个线程修改的计数器, 不需要原子的读-改-写
+template <typename T>
+static void Add(std::atomic<T>* counter, T delta)
+{
+    counter->store(counter->load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+}
+
+template <typename T>
+static void Sub(std::atomic<T>* counter, T delta)
+{
+    counter->store(counter->load(std::memory_order_relaxed) - delta, std::memory_order_relaxed);
+}
+
+SlabPool::SlabPool()
+    : RemoteFrees_(nullptr)
+    , refs_(0)
+    , MaxRetained_(kDefaultMaxRetained)
+    , allocations_(0)
+    , hits_(0)
+    , RemoteFreeCount_(0)
+    , outstanding_(0)
+    , retained_(0)
+{
+    for (int i = 0; i < kNumClasses; i++)
+    {
+        FreeLists_[i] = nullptr;
+    }
+}
+
+void SlabPool::Attach()
+{
+    t_CurrentPool = this;
+}
+
+void SlabPool::Detach()
+{
+    if (t_CurrentPool == this)
+    {
+        t_CurrentPool = nullptr;
+    }
+
+    // 关闭remote栈, 与其他线程的CAS互斥: 每个块要么在这里被取回, 要么在Free中看到kClosed
+    MaxRetained_.store(0, std::memory_order_relaxed);
+    BlockHeader* block = RemoteFrees_.exchange(kClosed, std::memory_order_acquire);
+    while (block != nullptr)
+    {
+        BlockHeader* next = Next(block);
+        ::operator delete(block);
+        Sub<uint64_t>(&outstanding_, 1);
+        block = next;
+    }
+    for (int i = 0; i < kNumClasses; i++)
+    {
+        while (FreeLists_[i] != nullptr)
+        {
+            block = FreeLists_[i];
+            FreeLists_[i] = Next(block);
+            ::operator delete(block);
+        }
+    }
+    retained_.store(0, std::memory_order_relaxed);
+
+    // 此前在关闭的栈上释放的块已经把refs_减成负数, 加上未释放的块数之后为0说明全部释放
+    long outstanding = static_cast<long>(outstanding_.load(std::memory_order_relaxed));
+    if (refs_.fetch_add(outstanding, std::memory_order_acq_rel) + outstanding == 0)
+    {
+        delete this;
+    }
+}
+
+void SlabPool::Unref(long count)
+{
+    if (refs_.fetch_sub(count, std::memory_order_acq_rel) == count)
+    {
+        delete this;
+    }
+}
+
+int SlabPool::SizeClass(size_t size)
+{
+    if (size <= kMinBlockSize)
+    {
+        return 0;
+    }
+    // 向上取整到2的幂: 64 ==> 0, 65~128 ==> 1 ...
+    return 64 - __builtin_clzl(size - 1) - 6;
+}
+
+void* SlabPool::Allocate(size_t size)
+{
+    SlabPool* pool = t_CurrentPool;
+    BlockHeader* block;
+    if (size + kHeaderSize >= kMmapThreshold)
+    {
+        size_t length = size + kHeaderSize;
+        void* addr = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (addr == MAP_FAILED)
+        {
+            throw std::bad_alloc();
+        }
+        block = static_cast<BlockHeader*>(addr);
+        block->owner = nullptr;
+        block->cls = length;
+    }
+    else if (pool == nullptr || size > kMaxAllocSize)
+    {
+        block = static_cast<BlockHeader*>(::operator new(size + kHeaderSize));
+        block->owner = nullptr;
+        block->cls = 0;
+    }
+    else
+    {
+        block = pool->AllocateLocal(SizeClass(size + kHeaderSize));
+    }
+    return block + 1;
+}
+
+void SlabPool::Free(void* ptr)
+{
+    if (ptr == nullptr)
+    {
+        return;
+    }
+    BlockHeader* block = static_cast<BlockHeader*>(ptr) - 1;
+    SlabPool* owner = block->owner;
+    if (owner == nullptr)
+    {
+        if (block->cls != 0)
+        {
+            munmap(block, block->cls);
+        }
+        else
+        {
+            ::operator delete(block);
+        }
+    }
+    else if (owner == t_CurrentPool)
+    {
+        owner->FreeLocal(block);
+    }
+    else
+    {
+        owner->FreeRemote(block);
+    }
+}
+
+SlabPool::BlockHeader* SlabPool::AllocateLocal(int cls)
+{
+    if (FreeLists_[cls] == nullptr && RemoteFrees_.load(std::memory_order_relaxed) != nullptr)
+    {
+        ReclaimRemote();
+    }
+
+    Add<uint64_t>(&allocations_, 1);
+    Add<uint64_t>(&outstanding_, 1);
+    BlockHeader* block = FreeLists_[cls];
+    if (block != nullptr)
+    {
+        FreeLists_[cls] = Next(block);
+        Sub<size_t>(&retained_, ClassSize(cls));
+        Add<uint64_t>(&hits_, 1);
+    }
+    else
+    {
+        block = static_cast<BlockHeader*>(::operator new(ClassSize(cls)));
+        block->owner = this;
+        block->cls = cls;
+    }
+    return block;
+}
+
+bool SlabPool::Retain(BlockHeader* block)
+{
+    size_t size = ClassSize(block->cls);
+    if (retained_.load(std::memory_order_relaxed) + size > MaxRetained_.load(std::memory_order_relaxed))
+    {
+        return false;
+    }
+    Next(block) = FreeLists_[block->cls];
+    FreeLists_[block->cls] = block;
+    Add<size_t>(&retained_, size);
+    return true;
+}
+
+void SlabPool::FreeLocal(BlockHeader* block)
+{
+    Sub<uint64_t>(&outstanding_, 1);
+    if (!Retain(block))
+    {
+        ::operator delete(block);
+    }
+}
+
+void SlabPool::FreeRemote(BlockHeader* block)
+{
+    BlockHeader* head = RemoteFrees_.load(std::memory_order_relaxed);
+    do
+    {
+        if (head == kClosed)
+        {
+            // 所属EventLoop已经析构
+            ::operator delete(block);
+            Unref(1);
+            return;
+        }
+        Next(block) = head;
+    } while (!RemoteFrees_.compare_exchange_weak(head, block, std::memory_order_release, std::memory_order_relaxed));
+}
+
+void SlabPool::ReclaimRemote()
+{
+    // 只有所属loop线程整体取走, 不存在ABA问题
+    BlockHeader* block = RemoteFrees_.exchange(nullptr, std::memory_order_acquire);
+    uint64_t count = 0;
+    while (block != nullptr)
+    {
+        BlockHeader* next = Next(block);
+        if (!Retain(block))
+        {
+            ::operator delete(block);
+        }
+        block = next;
+        ++count;
+    }
+    Add<uint64_t>(&RemoteFreeCount_, count);
+    Sub<uint64_t>(&outstanding_, count);
+}
+
+size_t SlabPool::Trim(size_t target)
+{
+    ReclaimRemote();
+    size_t released = 0;
+    for (int i = kNumClasses - 1; i >= 0 && retained_.load(std::memory_order_relaxed) > target; i--)
+    {
+        while (FreeLists_[i] != nullptr && retained_.load(std::memory_order_relaxed) > target)
+        {
+            BlockHeader* block = FreeLists_[i];
+            FreeLists_[i] = Next(block);
+            ::operator delete(block);
+            Sub<size_t>(&retained_, ClassSize(i));
+            released += ClassSize(i);
+        }
+    }
+    return released;
+}
+
+SlabPool::Stats SlabPool::GetStats() const
+{
+    Stats stats;
+    stats.allocations = allocations_.load(std::memory_order_relaxed);
+    stats.hits = hits_.load(std::memory_order_relaxed);
+    stats.remotefrees = RemoteFreeCount_.load(std::memory_order_relaxed);
+    stats.inuseblocks = outstanding_.load(std::memory_order_relaxed);
+    stats.retainedbytes = retained_.load(std::memory_order_relaxed);
+    return stats;
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <new>
+#include <utility>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "noncopyable.h"
+
+/*
+每个EventLoop一个的小块内存池, 用于连接对象, Channel/Socket, 缓冲区等随连接创建和销毁的内存
+按块大小(包括16字节的块头)分成64B, 128B ... 16KB共9个级别, 每个级别一个空闲链表
+
+loop线程中分配和释放只操作本线程内存池的空闲链表, 不加锁
+其他线程释放的块放进所属内存池的remote栈(一次CAS), 所属loop在空闲链表为空时一次性取回
+不在loop线程中或者超过16KB的分配直接使用operator new, 释放时由块头区分
+不小于128KB的分配直接mmap, 释放时立即还给系统(glibc的mmap阈值是动态的, 释放过大块之后会升高,
+之后的大块留在堆中, 连接收过一次大消息之后RSS就降不下来)
+
+所属loop自己统计未释放的块数, 分配和释放路径上没有原子的读-改-写操作
+EventLoop析构时把remote栈标记为关闭, 之后其他线程释放的块直接还给系统, 最后一个块释放时销毁内存池
+*/
+class SlabPool: noncopyable
+{
+public:
+    static const size_t kMinBlockSize = 64;
+    static const size_t kMaxBlockSize = 16 * 1024;
+    static const int kNumClasses = 9;
+    static const size_t kHeaderSize = 16;
+    static const size_t kMaxAllocSize = kMaxBlockSize - kHeaderSize; // 能从内存池分配的最大字节数
+    static const size_t kMmapThreshold = 128 * 1024;
+    static const size_t kDefaultMaxRetained = 16 * 1024 * 1024;
+    static const size_t kDefaultTrimTarget = 1024 * 1024;
+
+    struct Stats
+    {
+        uint64_t allocations; // 从内存池分配的次数
+        uint64_t hits; // 其中直接用空闲块满足的次数
+        uint64_t remotefrees; // 其他线程释放回来的块数
+        uint64_t inuseblocks; // 已经分配还没有释放的块数
+        size_t retainedbytes; // 空闲链表中保留的字节数
+    };
+
+    // 从当前线程EventLoop的内存池分配, 可以在任意线程中调用
+    static void* Allocate(size_t size);
+    // 释放Allocate分配的内存, 可以在任意线程中调用
+    static void Free(void* ptr);
+
+    // 空闲链表最多保留的字节数, 超出时释放的块直接还给系统, 0表示不保留
+    void SetMaxRetainedBytes(size_t bytes) { MaxRetained_.store(bytes, std::memory_order_relaxed); }
+    // 统计信息, 可以在任意线程中读取(近似值)
+    Stats GetStats() const;
+    // 释放空闲链表中的块, 直到保留的字节数不超过target, 返回释放的字节数, 只能在所属loop线程中调用
+    // 从最大的级别开始释放, 连接对象等常用小块的空闲链表尽量保留
+    size_t Trim(size_t target);
+
+private:
+    friend class EventLoop;
+
+    struct BlockHeader
+    {
+        SlabPool* owner; // nullptr表示不属于内存池
+        size_t cls; // 不属于内存池时: 0表示operator new分配, 否则是mmap的长度
+    };
+
+    static BlockHeader* const kClosed; // Detach之后remote栈的取值
+
+    SlabPool();
+    ~SlabPool() = default; // 空闲块在Detach时已经释放
+
+    // 由EventLoop在loop线程中调用: 成为当前线程的内存池 / 解除, 没有未释放的块时销毁
+    void Attach();
+    void Detach();
+
+    BlockHeader* AllocateLocal(int cls);
+    void FreeLocal(BlockHeader* block);
+    void FreeRemote(BlockHeader* block);
+    void ReclaimRemote(); // 取回其他线程释放的块
+    bool Retain(BlockHeader* block); // 放进空闲链表, 超出保留上限时返回false
+    void Unref(long count); // Detach之后其他线程释放了count个块
+
+    static int SizeClass(size_t size);
+    static size_t ClassSize(int cls) { return kMinBlockSize << cls; }
+    static BlockHeader*& Next(BlockHeader* block) { return *reinterpret_cast<BlockHeader**>(block + 1); }
+
+    BlockHeader* FreeLists_[kNumClasses]; // 只在所属loop线程中访问
+    std::atomic<BlockHeader*> RemoteFrees_; // Detach之后为kClosed
+    std::atomic<long> refs_; // Detach时加上未释放的块数, 之后每释放一块减一, 减到0时销毁
+    std::atomic<size_t> MaxRetained_;
+
+    // 只由所属loop线程修改
+    std::atomic<uint64_t> allocations_;
+    std::atomic<uint64_t> hits_;
+    std::atomic<uint64_t> RemoteFreeCount_;
+    std::atomic<uint64_t> outstanding_; // 未释放的块数, 其他线程释放的块取回时才扣除
+    std::atomic<size_t> retained_;
+};
+
+// 使用SlabPool的分配器, 用于std::allocate_shared和容器; 无状态, 任意两个实例都相等
+template <typename T>
+class SlabAllocator
+{
+public:
+    using value_type = T;
+
+    SlabAllocator() {}
+    template <typename U>
+    SlabAllocator(const SlabAllocator<U>&) {}
+
+    T* allocate(size_t n) { return static_cast<T*>(SlabPool::Allocate(n * sizeof(T))); }
+    void deallocate(T* ptr, size_t) { SlabPool::Free(ptr); }
+
+    // 不带参数时默认初始化, vector<char>扩容时不清零(Buffer总是先写后读)
+    template <typename U>
+    void construct(U* ptr) { ::new (static_cast<void*>(ptr)) U; }
+    template <typename U, typename... Args>
+    void construct(U* ptr, Args&&... args) { ::new (static_cast<void*>(ptr)) U(std::forward<Args>(args)...); }
+
+    template <typename U>
+    bool operator==(const SlabAllocator<U>&) const { return true; }
+    template <typename U>
+    bool operator!=(const SlabAllocator<U>&) const { return false; }
+};
@@ -73,4 +73,10 @@ void Socket::SetKeepAlive(bool on)
 {
     int optval = on ? 1 : 0;
     setsockopt(sockfd_, SOL_SOCKET, SO_KEEPALIVE, &optval, sizeof(optval));
+}
+
+void Socket::SetBusyPoll(int usec)
+{
+    int optval = usec;
+    setsockopt(sockfd_, SOL_SOCKET, SO_BUSY_POLL, &optval, sizeof(optval));
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "noncopyable.h"
+#include "SlabPool.h"
 
 class InetAddress;
 
@@ -11,6 +12,10 @@ public:
     explicit Socket(int sockfd): sockfd_(sockfd) {}
     ~Socket();
 
+    // 随连接创建和销毁, 从当前loop的内存池分配
+    static void* operator new(size_t size) { return SlabPool::Allocate(size); }
+    static void operator delete(void* ptr) { SlabPool::Free(ptr); }
+
     int Fd() const { return sockfd_; }
     void BindAddress(const InetAddress& localaddr);
     void Listen();
@@ -22,6 +27,7 @@ public:
     void SetReuseAddr(bool on);
     void SetReusePort(bool on);
     void SetKeepAlive(bool on);
+    void SetBusyPoll(int usec); // SO_BUSY_POLL, 读空时在驱动层忙等usec微秒
 
 private:
     const int sockfd_;
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <utility>
+#include <stddef.h>
+
+#include "noncopyable.h"
+
+/*
+有界的单生产者单消费者环形队列, 用于两个loop之间传递消息
+容量向上取整到2的幂, 元素预先构造好, 入队/出队只是移动赋值和一次release写, 不分配内存
+生产者和消费者各自缓存对方的下标, 只有缓存的下标显示满/空时才读取对方的原子变量, 减少cache line的来回传递
+*/
+template <typename T>
+class SpscRing: noncopyable
+{
+public:
+    explicit SpscRing(size_t capacity)
+        : slots_(RoundUp(capacity))
+        , mask_(slots_.size() - 1)
+        , head_(0)
+        , CachedTail_(0)
+        , tail_(0)
+        , CachedHead_(0)
+    {}
+
+    // 只能在生产者线程调用, 队列满时返回false, value不会被移动
+    bool TryPush(T& value)
+    {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head - CachedTail_ == slots_.size())
+        {
+            CachedTail_ = tail_.load(std::memory_order_acquire);
+            if (head - CachedTail_ == slots_.size())
+            {
+                return false;
+            }
+        }
+        slots_[head & mask_] = std::move(value);
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 只能在消费者线程调用, 队列空时返回false
+    bool TryPop(T* value)
+    {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail == CachedHead_)
+        {
+            CachedHead_ = head_.load(std::memory_order_acquire);
+            if (tail == CachedHead_)
+            {
+                return false;
+            }
+        }
+        *value = std::move(slots_[tail & mask_]);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 近似值, 可以在任意线程调用
+    size_t Size() const
+    {
+        return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+    }
+    size_t Capacity() const { return slots_.size(); }
+
+private:
+    static size_t RoundUp(size_t n)
+    {
+        size_t size = 2;
+        while (size < n)
+        {
+            size <<= 1;
+        }
+        return size;
+    }
+
+    static const int kCacheLineSize = 64;
+
+    std::vector<T> slots_;
+    const size_t mask_;
+
+    // 用整条cache line的填充隔开生产者和消费者的变量, 不用alignas: C++11的new不保证超过16字节的对齐
+    // 间隔不小于cache line时, 无论对象的起始地址是否对齐, 两组变量都不会落在同一条cache line上
+    char pad0_[kCacheLineSize];
+    std::atomic<size_t> head_; // 生产者写入的位置
+    size_t CachedTail_; // 生产者看到的tail_
+    char pad1_[kCacheLineSize];
+    std::atomic<size_t> tail_; // 消费者读取的位置
+    size_t CachedHead_; // 消费者看到的head_
+    char pad2_[kCacheLineSize];
+};
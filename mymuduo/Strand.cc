@@ -0,0 +1,92 @@
+#include <thread>
+
+#include "Strand.h"
+#include "ComputePool.h"
+#include "EventLoop.h"
+
+// 一次Drain中最多攒多少个continuation再投递给loop
+static const size_t kMaxContinuationBatch = 64;
+// 一次Drain最多执行多少个任务, 之后重新提交, 让同一个worker上的其他任务也有机会执行
+static const int kMaxJobsPerDrain = 256;
+
+Strand::Strand(EventLoop* loop, ComputePool* pool)
+    : loop_(loop)
+    , pool_(pool)
+    , PendingJobs_(0)
+{
+    loop_->Ref(); // continuation要投递回loop, 见EventLoop::Ref
+}
+
+Strand::~Strand()
+{
+    loop_->Unref();
+}
+
+void Strand::Post(Task task, Task continuation)
+{
+    jobs_.Push(Job{std::move(task), std::move(continuation)});
+    if (PendingJobs_.fetch_add(1, std::memory_order_acq_rel) == 0)
+    {
+        // Drain持有Strand的shared_ptr, 连接析构后已经投递的任务仍然会执行完
+        pool_->Submit(std::bind(&Strand::Drain, shared_from_this()));
+    }
+}
+
+static void RunContinuations(const std::vector<Strand::Task>& continuations)
+{
+    for (const Strand::Task& continuation : continuations)
+    {
+        continuation();
+    }
+}
+
+void Strand::FlushContinuations(std::vector<Task>* continuations)
+{
+    if (!continuations->empty())
+    {
+        std::vector<Task> batch;
+        batch.swap(*continuations);
+        loop_->QueneInLoop(std::bind(&RunContinuations, std::move(batch)), EventLoop::kBulk);
+    }
+}
+
+void Strand::Drain()
+{
+    std::vector<Task> continuations;
+    for (int executed = 1; ; executed++)
+    {
+        Job job;
+        // 计数已经包含了这个任务, 只是生产者可能还没有完成链接
+        while (!jobs_.Pop(&job))
+        {
+            std::this_thread::yield();
+        }
+        job.task();
+        if (job.continuation)
+        {
+            continuations.push_back(std::move(job.continuation));
+            if (continuations.size() >= kMaxContinuationBatch)
+            {
+                FlushContinuations(&continuations);
+            }
+        }
+
+        // 可能是最后一个任务, 先把continuation投递出去再减计数
+        // 否则减到0之后新调度的Drain可能先投递, 打乱continuation的顺序
+        if (PendingJobs_.load(std::memory_order_acquire) == 1)
+        {
+            FlushContinuations(&continuations);
+        }
+        if (PendingJobs_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            break;
+        }
+        if (executed >= kMaxJobsPerDrain)
+        {
+            // 计数没有归零, 调度权还在本次Drain手里, 交给重新提交的Drain继续
+            FlushContinuations(&continuations);
+            pool_->Submit(std::bind(&Strand::Drain, shared_from_this()));
+            break;
+        }
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <atomic>
+#include <vector>
+
+#include "noncopyable.h"
+#include "MpscQueue.h"
+
+class EventLoop;
+class ComputePool;
+
+/*
+串行执行器: 投递到同一个Strand的任务在ComputePool中按FIFO顺序逐个执行, 同一时刻最多占用一个worker
+continuation按任务的顺序回到loop执行, 不同的Strand之间互不影响, 可以并行
+投递只是一次无锁入队和一次原子加, 只有Strand从空闲变为忙碌时才向ComputePool提交一个排空任务
+*/
+class Strand: noncopyable, public std::enable_shared_from_this<Strand>
+{
+public:
+    using Task = std::function<void()>;
+
+    Strand(EventLoop* loop, ComputePool* pool);
+    ~Strand();
+
+    // 可以在任意线程调用, 同一线程投递的任务按投递顺序执行
+    void Post(Task task, Task continuation = Task());
+
+    EventLoop* GetLoop() const { return loop_; }
+
+private:
+    struct Job
+    {
+        Task task;
+        Task continuation;
+    };
+
+    void Drain(); // 在worker线程中执行, 直到队列为空
+    void FlushContinuations(std::vector<Task>* continuations);
+
+    EventLoop* loop_;
+    ComputePool* pool_;
+    MpscQueue<Job> jobs_;
+    std::atomic<size_t> PendingJobs_; // 已投递还没有执行完的任务数, 从0变为1的投递者负责调度Drain
+};
+
+using StrandPtr = std::shared_ptr<Strand>;
@@ -1,4 +1,5 @@
 #include <functional>
+#include <algorithm>
 
 #include <errno.h>
 
@@ -32,24 +33,31 @@ TcpConnection::TcpConnection(EventLoop* loop,
     , LocalAddr_(local_addr)
     , PeerAddr_(peer_addr)
     , HighWaterMark_(64*1024*1024) // 64M
+    , EventByteBudget_(1024*1024) // 1M
+    , IdleTimeout_(0.0)
+    , BufferShrinkIdle_(0.0)
+    , CoroutineReading_(false)
+    , ReadBytes_(0)
 {
     // 给Channel设置相应的回调函数, Poller给Channel通知感兴趣的事件发生, channel会调用相应的操作函数
-    channel_->SetReadCallback(std::bind(&TcpConnection::HandleRead, this, 
-                                        std::placeholders::_1));
+    // 只捕获this的lambda可以放进std::function内部, 不需要额外分配内存(std::bind成员函数需要)
+    channel_->SetReadCallback([this](TimeStamp receive_time) { HandleRead(receive_time); });
 
-    channel_->SetWriteCallback(std::bind(&TcpConnection::HandleWrite, this));
+    channel_->SetWriteCallback([this]() { HandleWrite(); });
 
-    channel_->SetCloseCallback(std::bind(&TcpConnection::HandleClose, this));
+    channel_->SetCloseCallback([this]() { HandleClose(); });
 
-    channel_->SetErrorCallback(std::bind(&TcpConnection::HandleError, this));
+    channel_->SetErrorCallback([this]() { HandleError(); });
 
     LOG_INFO("TcpConnection::ctor[%s] at fd=%d\n", name_.c_str(), sockfd);
     socket_->SetKeepAlive(true);
+    loop_->Ref(); // 用户可能在连接关闭之后仍持有TcpConnectionPtr, loop要活得比连接对象久
 }
 
 TcpConnection::~TcpConnection()
 {
     LOG_INFO("TcpConnection::dtor[%s] at fd = %d state = %d\n", name_.c_str(), channel_->Fd(), (int)state_);
+    loop_->Unref();
 }
 
 void TcpConnection::Send(const std::string& buf)
@@ -62,7 +70,8 @@ void TcpConnection::Send(const std::string& buf)
         }
         else
         {
-            loop_->RunInLoop(std::bind(&TcpConnection::SendInLoop, this, buf.c_str(), buf.size()));
+            // 跨线程发送时调用者的buf可能先于回调被释放, 需要拷贝一份数据, 并持有连接的引用
+            loop_->RunInLoop(std::bind(&TcpConnection::SendStringInLoop, shared_from_this(), buf));
         }
     }
 }
@@ -76,40 +85,212 @@ void TcpConnection::Shutdown()
     }
 }
 
+void TcpConnection::ForceClose()
+{
+    if (state_ == kConnected || state_ == kDisconnecting)
+    {
+        SetState(kDisconnecting);
+        loop_->QueneInLoop(std::bind(&TcpConnection::ForceCloseInLoop, shared_from_this()));
+    }
+}
+
+void TcpConnection::ForceCloseInLoop()
+{
+    if (state_ == kConnected || state_ == kDisconnecting)
+    {
+        HandleClose();
+    }
+}
+
+void TcpConnection::SetBusyPoll(int usec)
+{
+    socket_->SetBusyPoll(usec);
+}
+
+void TcpConnection::SetTcpNoDelay(bool on)
+{
+    socket_->SetTcpNoDelay(on);
+}
+
+const StrandPtr& TcpConnection::GetStrand()
+{
+    if (!strand_)
+    {
+        strand_ = std::make_shared<Strand>(loop_, loop_->GetComputePool());
+    }
+    return strand_;
+}
+
+void TcpConnection::Offload(std::function<void()> task, std::function<void()> continuation)
+{
+    GetStrand()->Post(std::move(task), std::move(continuation));
+}
+
+ReadAwaiter TcpConnection::Read(size_t n)
+{
+    CoroutineReading_ = true;
+    ReadBytes_ = n;
+    ReadDelim_.clear();
+    return ReadAwaiter(shared_from_this());
+}
+
+ReadAwaiter TcpConnection::ReadUntil(const std::string& delim)
+{
+    CoroutineReading_ = true;
+    ReadBytes_ = 0;
+    ReadDelim_ = delim;
+    return ReadAwaiter(shared_from_this());
+}
+
+WriteAwaiter TcpConnection::Write(const std::string& data)
+{
+    Send(data);
+    return WriteAwaiter(shared_from_this());
+}
+
+bool TcpConnection::ReadReady() const
+{
+    if (state_ == kDisconnected)
+    {
+        return true;
+    }
+    if (ReadDelim_.empty())
+    {
+        return InputBuffer_.ReadableBytes() >= ReadBytes_;
+    }
+    const char* begin = InputBuffer_.Peek();
+    const char* end = InputBuffer_.BeginWrite();
+    return std::search(begin, end, ReadDelim_.begin(), ReadDelim_.end()) != end;
+}
+
+std::string TcpConnection::TakeRead()
+{
+    if (ReadDelim_.empty())
+    {
+        return InputBuffer_.RetrieveAsString(std::min(ReadBytes_, InputBuffer_.ReadableBytes()));
+    }
+    const char* begin = InputBuffer_.Peek();
+    const char* end = InputBuffer_.BeginWrite();
+    const char* found = std::search(begin, end, ReadDelim_.begin(), ReadDelim_.end());
+    if (found == end)
+    {
+        return InputBuffer_.RetrieveAllAsString(); // 连接已经关闭, 没有等到delim
+    }
+    return InputBuffer_.RetrieveAsString(found - begin + ReadDelim_.size());
+}
+
+// 先取出再恢复, 协程恢复之后可能立即发起下一次等待
+void TcpConnection::ResumeWaiter(std::function<void()>* waiter)
+{
+    std::function<void()> resume;
+    resume.swap(*waiter);
+    resume();
+}
+
+void TcpConnection::SetEdgeTriggered(bool on)
+{
+    channel_->SetEdgeTriggered(on);
+}
+
 void TcpConnection::ConnectEstablished()
 {
+    // 连接对象在所属loop线程中从它的内存池创建, 缓冲区在第一次收发数据时才分配, 同样落在loop所在的NUMA节点上
     SetState(kConnected);
     channel_->Tie(shared_from_this());
     channel_->EnableReading(); // 向Poller注册Channel的epollin事件
 
+    if (IdleTimeout_ > 0)
+    {
+        // IdleEntry_是成员, 在HandleClose/ConnectDestoryed中会先从时间轮上摘除, 这里可以直接绑定this
+        loop_->GetTimingWheel()->Add(&IdleEntry_, IdleTimeout_, std::bind(&TcpConnection::HandleIdleTimeout, this));
+    }
+
     // 新连接建立, 执行回调
     connectioncallback_(shared_from_this());
 }
 
 void TcpConnection::ConnectDestoryed()
 {
-    if (state_ == kConnected)
+    // 已经Shutdown的连接也要置为断开, 下面恢复的协程再次等待时不会挂起
+    if (state_ == kConnected || state_ == kDisconnecting)
     {
         SetState(kDisconnected);
         channel_->DisableAll(); // 把Channel的所有感兴趣事件从Poller中del
     }
     channel_->Remove(); // 把Channel从Poller中del
+    if (IdleEntry_.Linked())
+    {
+        loop_->GetTimingWheel()->Remove(&IdleEntry_);
+    }
+    if (ShrinkEntry_.Linked())
+    {
+        loop_->GetTimingWheel()->Remove(&ShrinkEntry_);
+    }
+
+    // TcpServer析构时连接不经过HandleClose, 等待中的协程在这里恢复, 看到连接已经断开
+    // 否则连接持有协程句柄, 协程帧持有TcpConnectionPtr, 两者都不会释放
+    if (ReadWaiter_)
+    {
+        ResumeWaiter(&ReadWaiter_);
+    }
+    if (WriteWaiter_)
+    {
+        ResumeWaiter(&WriteWaiter_);
+    }
 }
 
 void TcpConnection::HandleRead(TimeStamp reveive_time)
 {
+    // 预算耗尽后重新排队的读操作, 执行前连接可能已经关闭
+    if (state_ == kDisconnected)
+    {
+        return;
+    }
+
+    // LT模式只读一次; ET模式一直读到EAGAIN, 或者用完本次事件的字节预算
     int saved_errno = 0;
-    ssize_t n = InputBuffer_.ReadFd(channel_->Fd(), &saved_errno);
+    size_t total = 0;
+    ssize_t n = 0;
+    do
+    {
+        n = InputBuffer_.ReadFd(channel_->Fd(), &saved_errno);
+        if (n > 0)
+        {
+            total += n;
+        }
+    } while (n > 0 && channel_->IsEdgeTriggered() && total < EventByteBudget_);
+
+    if (total > 0)
+    {
+        TouchIdle();
+        if (CoroutineReading_)
+        {
+            if (ReadWaiter_ && ReadReady())
+            {
+                ResumeWaiter(&ReadWaiter_);
+            }
+        }
+        else if (messagecallback_)
+        {
+            // 已建立连接的用户, 有可读事件发生了, 调用用户传入的回调操作OnMessage
+            messagecallback_(shared_from_this(), &InputBuffer_, reveive_time);
+        }
+        ReclaimInputBuffer();
+    }
+
     if (n > 0)
     {
-        // 已建立连接的用户, 有可读事件发生了, 调用用户传入的回调操作OnMessage
-        messagecallback_(shared_from_this(), &InputBuffer_, reveive_time);
+        if (channel_->IsEdgeTriggered())
+        {
+            // 预算用完但数据没读完, ET模式不会再通知, 排到本轮其他事件之后继续读
+            loop_->QueneInLoop(std::bind(&TcpConnection::HandleRead, shared_from_this(), reveive_time));
+        }
     }
     else if (n == 0)
     {
         HandleClose();
     }
-    else
+    else if (saved_errno != EAGAIN && saved_errno != EWOULDBLOCK)
     {
         errno = saved_errno;
         LOG_ERROR("TcpConnection::HandleRead error\n");
@@ -121,11 +302,23 @@ void TcpConnection::HandleWrite()
 {
     if (channel_->IsWriting())
     {
+        // LT模式只写一次; ET模式一直写到EAGAIN/缓冲区清空, 或者用完本次事件的字节预算
         int saved_errno = 0;
-        ssize_t n = OutputBuffer_.WriteFd(channel_->Fd(), &saved_errno);
-        if (n > 0)
+        size_t total = 0;
+        while (true)
         {
+            ssize_t n = OutputBuffer_.WriteFd(channel_->Fd(), &saved_errno);
+            if (n <= 0)
+            {
+                if (!channel_->IsEdgeTriggered() || n == 0 || saved_errno != EWOULDBLOCK)
+                {
+                    LOG_ERROR("TcpConnection::HandleWrite error");
+                }
+                break;
+            }
+
             OutputBuffer_.Retrieve(n);
+            total += n;
             if (OutputBuffer_.ReadableBytes() == 0)
             {
                 channel_->DisableWriting();
@@ -133,15 +326,26 @@ void TcpConnection::HandleWrite()
                 {
                     loop_->QueneInLoop(std::bind(writecompletecallback_, shared_from_this()));
                 }   
+                if (WriteWaiter_)
+                {
+                    ResumeWaiter(&WriteWaiter_);
+                }
                 if (state_ == kDisconnecting)
                 {
                     ShutdownInLoop();
                 }
-            } 
-        }
-        else
-        {
-            LOG_ERROR("TcpConnection::HandleWrite error");
+                break;
+            }
+            if (!channel_->IsEdgeTriggered())
+            {
+                break;
+            }
+            if (total >= EventByteBudget_)
+            {
+                // 预算用完但socket仍然可写, ET模式不会再通知, 排到本轮其他事件之后继续写
+                loop_->QueneInLoop(std::bind(&TcpConnection::HandleWrite, shared_from_this()));
+                break;
+            }
         }
     }
    else
@@ -156,8 +360,25 @@ void TcpConnection::HandleClose()
     LOG_INFO("TcpConnection::HandleClose error, fd = %d state = %d\n", channel_->Fd(), (int)state_);
     SetState(kDisconnected);
     channel_->DisableAll();
+    if (IdleEntry_.Linked())
+    {
+        loop_->GetTimingWheel()->Remove(&IdleEntry_);
+    }
+    if (ShrinkEntry_.Linked())
+    {
+        loop_->GetTimingWheel()->Remove(&ShrinkEntry_);
+    }
 
     TcpConnectionPtr ConnPtr(shared_from_this());
+    // 等待中的协程先恢复, 读到剩下的数据, 看到连接已经断开
+    if (ReadWaiter_)
+    {
+        ResumeWaiter(&ReadWaiter_);
+    }
+    if (WriteWaiter_)
+    {
+        ResumeWaiter(&WriteWaiter_);
+    }
     connectioncallback_(ConnPtr); // 执行连接关闭的回调
     closecallback_(ConnPtr); // 关闭连接的回调 执行的是TcpServer::RemoveConnection回调方法
 }
@@ -191,6 +412,7 @@ void TcpConnection::SendInLoop(const void* data, size_t len)
         LOG_ERROR("disconnected, give up writing\n");
         return;
     }
+    TouchIdle();
     //  表示channel——第一次开始写数据, 而且缓冲区没有待发送数据
     if (!channel_->IsWriting() && OutputBuffer_.ReadableBytes() == 0)
     {
@@ -223,7 +445,8 @@ void TcpConnection::SendInLoop(const void* data, size_t len)
     if (!fault_error && remaining > 0)
     {
         size_t old_len = OutputBuffer_.ReadableBytes();
-        if (old_len + remaining <= HighWaterMark_ && old_len < HighWaterMark_ && highwatermarkcallback_)
+        // 只在这次追加越过高水位时回调一次, 已经在高水位之上的追加不再重复回调
+        if (old_len + remaining >= HighWaterMark_ && old_len < HighWaterMark_ && highwatermarkcallback_)
         {
             loop_->QueneInLoop(std::bind(highwatermarkcallback_, shared_from_this(), old_len+remaining));
         }
@@ -235,6 +458,58 @@ void TcpConnection::SendInLoop(const void* data, size_t len)
     }
 }
 
+void TcpConnection::TouchIdle()
+{
+    if (IdleEntry_.Linked())
+    {
+        loop_->GetTimingWheel()->Touch(&IdleEntry_);
+    }
+}
+
+// 时间轮回调, 连接在IdleTimeout_秒内没有收发数据
+void TcpConnection::HandleIdleTimeout()
+{
+    LOG_INFO("TcpConnection::HandleIdleTimeout [%s] idle for %.1f seconds, force close\n", name_.c_str(), IdleTimeout_);
+    ForceClose();
+}
+
+void TcpConnection::ReclaimInputBuffer()
+{
+    if (InputBuffer_.ReadableBytes() == 0 && InputBuffer_.Capacity() <= SlabPool::kMaxAllocSize
+        && InputBuffer_.GetBackend() == Buffer::kVectorBackend)
+    {
+        // 消息已经全部处理完, 小块缓冲区还给loop的内存池, 下次从内存池中取回仍然是热的
+        InputBuffer_.Shrink();
+        if (ShrinkEntry_.Linked())
+        {
+            loop_->GetTimingWheel()->Remove(&ShrinkEntry_);
+        }
+    }
+    else if (BufferShrinkIdle_ > 0 && state_ == kConnected)
+    {
+        // 大块缓冲区立即释放的话, 下一个大消息要重新分配并触发缺页, 连接活跃期间保留
+        // 留有不完整的消息或者大块缓冲区, 一段时间内没有新数据就收缩; 只有这样的连接才挂在时间轮上
+        if (ShrinkEntry_.Linked())
+        {
+            loop_->GetTimingWheel()->Touch(&ShrinkEntry_);
+        }
+        else
+        {
+            // ShrinkEntry_与IdleEntry_一样在HandleClose/ConnectDestoryed中摘除, 可以直接绑定this
+            loop_->GetTimingWheel()->Add(&ShrinkEntry_, BufferShrinkIdle_, [this]() { HandleBufferShrink(); });
+        }
+    }
+}
+
+// 时间轮回调, 输入缓冲区BufferShrinkIdle_秒内没有新数据
+void TcpConnection::HandleBufferShrink()
+{
+    LOG_DEBUG("TcpConnection::HandleBufferShrink [%s] input buffer %lu bytes, %lu readable\n", name_.c_str(),
+              (unsigned long)InputBuffer_.Capacity(), (unsigned long)InputBuffer_.ReadableBytes());
+    InputBuffer_.Shrink();
+    loop_->TrimMemory();
+}
+
 void TcpConnection::ShutdownInLoop()
 {
    if (!channel_->IsWriting()) // 说明OutputBuffer_中的数据已经全部发送完成
@@ -8,11 +8,16 @@
 #include "InetAddress.h"
 #include "Callbacks.h"
 #include "Buffer.h"
+#include "ChainBuffer.h"
 #include "Timestamp.h"
+#include "TimingWheel.h"
+#include "Strand.h"
 
 class Channel;
 class EventLoop;
 class Socket;
+class ReadAwaiter;
+class WriteAwaiter;
 
 /*
 TcpServer ==> Acceptor ==> 有一个新用户连接, 通过accept函数拿到connfd
@@ -41,17 +46,59 @@ public:
     void Send(const std::string& buf);
     // 关闭连接
     void Shutdown();
+    // 不等待数据发送完, 直接关闭连接
+    void ForceClose();
 
     void SetConnectionCallback(const ConnectionCallback& cb) { connectioncallback_ = cb; }
     void SetMessageCallback(const MessageCallback& cb) { messagecallback_ = cb; }
     void SetWriteCompleteCallback(const WriteCompleteCallback& cb) { writecompletecallback_ = cb; }
     void SetHighWaterMarkCallback(const HighWaterMarkCallback& cb) { highwatermarkcallback_ = cb; }
+    // 输出缓冲区的高水位, 超过时执行HighWaterMarkCallback, co_await Write挂起
+    void SetHighWaterMark(size_t bytes) { HighWaterMark_ = bytes; }
     void SetCloseCallback(const CloseCallback& cb) { closecallback_ = cb; }
 
+    // 开启ET模式, 需要在ConnectEstablished之前设置
+    void SetEdgeTriggered(bool on);
+    // ET模式下一次事件最多读/写的字节数, 防止一个连接饿死同一个loop上的其他连接
+    void SetEventByteBudget(size_t bytes) { EventByteBudget_ = bytes; }
+    // seconds秒内没有收发数据就强制关闭连接, 需要在ConnectEstablished之前设置
+    void SetIdleTimeout(double seconds) { IdleTimeout_ = seconds; }
+    // 缓冲区在第一次收发数据时才分配, 读空/发送完之后不超过16KB的缓冲区立即还给loop的内存池
+    // 更大的输入缓冲区, 或者留有不完整的消息时, seconds秒内没有新数据就收缩到只保留未读的数据, <= 0表示不收缩
+    void SetBufferShrinkIdle(double seconds) { BufferShrinkIdle_ = seconds; }
+    // 输入缓冲区的底层存储, 需要在ConnectEstablished之前设置
+    // kMirrorBackend的环读空之后也保留, 只由SetBufferShrinkIdle的空闲收缩释放
+    void SetBufferBackend(Buffer::Backend backend) { InputBuffer_.SetBackend(backend); }
+    // 给连接的socket设置SO_BUSY_POLL
+    void SetBusyPoll(int usec);
+    // 关闭Nagle算法
+    void SetTcpNoDelay(bool on);
+
+    // 在loop的计算线程池中按投递顺序串行执行task, continuation按同样的顺序回到本连接的loop执行
+    // 不同连接的任务可以并行, 在continuation中Send即可保证回复有序, 只能在loop线程中调用
+    void Offload(std::function<void()> task, std::function<void()> continuation = std::function<void()>());
+    // 本连接的Strand, 第一次使用时创建, 只能在loop线程中调用
+    const StrandPtr& GetStrand();
+
+    /*
+    协程接口, 需要C++20, 协程类型见Coroutine.h; 只能在loop线程中调用, 协程在本连接的loop中恢复
+    第一次调用Read/ReadUntil之后收到的数据留给协程读取, 不再执行MessageCallback
+    同一时刻最多一个读和一个写在等待
+    */
+    // 读取n字节; 连接关闭时返回剩下的数据, 可能不足n字节
+    ReadAwaiter Read(size_t n);
+    // 读取到delim为止(包含delim); 连接关闭时返回剩下的数据, 不包含delim
+    ReadAwaiter ReadUntil(const std::string& delim);
+    // 立即发送data, 输出缓冲区超过高水位时挂起, 直到缓冲区发送完; 返回false表示连接已经断开
+    WriteAwaiter Write(const std::string& data);
+
     void ConnectEstablished();
     void ConnectDestoryed();
 
 private:
+    friend class ReadAwaiter;
+    friend class WriteAwaiter;
+
     enum StateE {kDisconnected, kConnecting, kConnected, kDisconnecting};
 
     void SetState(StateE state) { state_ = state; }
@@ -62,7 +109,22 @@ private:
     void HandleError();
 
     void SendInLoop(const void* data, size_t len);
+    void SendStringInLoop(const std::string& buf) { SendInLoop(buf.data(), buf.size()); }
     void ShutdownInLoop();
+    void ForceCloseInLoop();
+
+    // 空闲超时检测
+    void TouchIdle();
+    void HandleIdleTimeout();
+    // 一次读事件处理完之后回收输入缓冲区
+    void ReclaimInputBuffer();
+    void HandleBufferShrink();
+
+    // 协程读写
+    bool ReadReady() const; // 请求的数据已经到齐, 或者连接已经关闭
+    std::string TakeRead();
+    bool WriteReady() const { return state_ != kConnected || OutputBuffer_.ReadableBytes() <= HighWaterMark_; }
+    static void ResumeWaiter(std::function<void()>* waiter);
 
     EventLoop* loop_; // 这里绝对不是BaseLoop, 因为TcpConnection都是在subloop里面管理的
     const std::string name_;
@@ -82,7 +144,52 @@ private:
     CloseCallback closecallback_;
 
     size_t HighWaterMark_;
+    size_t EventByteBudget_;
+
+    double IdleTimeout_; // <= 0表示不检测空闲连接
+    TimingWheel::Entry IdleEntry_; // 挂在loop的时间轮上
+    double BufferShrinkIdle_;
+    TimingWheel::Entry ShrinkEntry_; // 输入缓冲区留有数据时才挂在时间轮上
+    StrandPtr strand_;
+
+    bool CoroutineReading_; // 数据由协程读取, 不执行MessageCallback
+    size_t ReadBytes_; // 协程等待的字节数, ReadDelim_为空时有效
+    std::string ReadDelim_;
+    std::function<void()> ReadWaiter_; // 恢复等待读的协程
+    std::function<void()> WriteWaiter_;
 
     Buffer InputBuffer_;
-    Buffer OutputBuffer_;
-};
\ No newline at end of file
+    ChainBuffer OutputBuffer_; // slab链, 大块数据追加和发送时不移动已有数据
+};
+
+/*
+co_await的等待对象, 本身只依赖C++11, await_suspend是模板, 只在C++20的协程中实例化
+协程句柄保存在连接中, 条件满足时在loop线程中直接恢复, 不经过回调队列
+*/
+class ReadAwaiter
+{
+public:
+    explicit ReadAwaiter(TcpConnectionPtr conn): conn_(std::move(conn)) {}
+
+    bool await_ready() const { return conn_->ReadReady(); }
+    template <typename Handle>
+    void await_suspend(Handle handle) { conn_->ReadWaiter_ = [handle]() { handle.resume(); }; }
+    std::string await_resume() { return conn_->TakeRead(); }
+
+private:
+    TcpConnectionPtr conn_;
+};
+
+class WriteAwaiter
+{
+public:
+    explicit WriteAwaiter(TcpConnectionPtr conn): conn_(std::move(conn)) {}
+
+    bool await_ready() const { return conn_->WriteReady(); }
+    template <typename Handle>
+    void await_suspend(Handle handle) { conn_->WriteWaiter_ = [handle]() { handle.resume(); }; }
+    bool await_resume() const { return conn_->Connected(); }
+
+private:
+    TcpConnectionPtr conn_;
+};
@@ -22,25 +22,63 @@ TcpServer::TcpServer(EventLoop* loop,
     : loop_(CheckLoopNotNull(loop))
     , ipPort_(listen_addr.ToIpPort())
     , name_(name_arg)
+    , ListenAddr_(listen_addr)
+    , ReusePort_(option == kReusePort)
     , acceptor_(new Acceptor(loop, listen_addr, option == kReusePort))
     , ThreadPool_(new EventLoopThreadPool(loop, name_))
     , connectioncallback_()
     , messagecallback_()
-    , NextConnId_(1)
     , started_(0)
+    , NextConnId_(1)
+    , EdgeTriggered_(false)
+    , EventByteBudget_(1024*1024)
+    , IdleTimeout_(0.0)
+    , BufferShrinkIdle_(0.0)
+    , BufferBackend_(Buffer::kVectorBackend)
+    , LoopBusyPollUs_(0)
+    , SocketBusyPollUs_(0)
+    , AcceptBatch_(0)
+    , MaxConnections_(0)
+    , NumConnections_(0)
+    , AcceptPaused_(false)
 {
     // 当有新用户连接时, 会执行TcpServer::NewConnection回调 
     acceptor_->SetNewConnectionCallback(std::bind(&TcpServer::NewConnection, this, 
                                         std::placeholders::_1, std::placeholders::_2));
+    acceptor_->SetAcceptBatchCallback(std::bind(&TcpServer::DispatchNewConnections, this));
+    ThreadPool_->SetDrainCallback(std::bind(&TcpServer::DrainLoop, this,
+                                            std::placeholders::_1, std::placeholders::_2));
 }
 
 TcpServer::~TcpServer()
 {
+    if (!loop_->IsInLoopThread())
+    {
+        LOG_FATAL("TcpServer [%s] must be destroyed in the BaseLoop thread\n", name_.c_str());
+    }
+    // Acceptor的Channel属于subloop, 在subloop线程中注销并关闭监听socket
+    // 即使没有per-loop的Acceptor也要等一轮: 投递给subloop的EstablishConnections绑定了this,
+    // loop的回调按投递顺序执行, 等到广播执行时之前排队的批次都已经建立好连接, 在下面和其他连接一起销毁
+    // 等所有subloop都执行完再析构其他成员, 之后的accept不会再进入TcpServer
+    ThreadPool_->RunInAllLoopsAndWait([this]() {
+        EventLoop* current = EventLoop::LoopOfCurrentThread();
+        for (Acceptor* acceptor : LoopAcceptors_)
+        {
+            if (acceptor->GetLoop() == current)
+            {
+                delete acceptor;
+            }
+        }
+    });
+    LoopAcceptors_.clear();
+
+    std::lock_guard<std::mutex> lock(ConnectionsMutex_);
     for (auto& item : connections_)
     {
         // 这个局部的shared_ptr对象, 出右括号, 可以自动释放new出来的TcpConnection对象资源
         TcpConnectionPtr conn(item.second);
         item.second.reset();
+        conn->GetLoop()->ConnectionRemoved();
 
         // 销毁连接
         conn->GetLoop()->RunInLoop(std::bind(&TcpConnection::ConnectDestoryed, conn));
@@ -53,24 +91,131 @@ void TcpServer::SetThreadNum(int num_threads)
     ThreadPool_->SetThreadNum(num_threads);
 }
 
+void TcpServer::SetPollerBackend(Poller::Backend backend)
+{
+    ThreadPool_->SetPollerBackend(backend);
+}
+
+void TcpServer::SetAcceptBatch(int batch)
+{
+    AcceptBatch_ = batch;
+    acceptor_->SetAcceptBatch(batch);
+}
+
 // 开启服务器监听
 void TcpServer::Start()
 {
     if (started_++ == 0) // 防止一个TcpServer对象被启动多次
     {
-        ThreadPool_->Start(threadinitcallback_); // 启动底层的loop线程池
-        loop_->RunInLoop(std::bind(&Acceptor::Listen, acceptor_.get()));
+        // 自动扩容时新的subloop在运行期间创建, busy poll放在线程初始化回调中设置
+        ThreadPool_->Start(std::bind(&TcpServer::InitLoop, this, std::placeholders::_1)); // 启动底层的loop线程池
+
+        std::vector<EventLoop*> io_loops = ThreadPool_->GetAllLoops();
+        if (ReusePort_ && io_loops.front() != loop_)
+        {
+            // BaseLoop的监听socket只占住端口, 不listen, 由内核在各个subloop的监听socket之间分发连接
+            for (EventLoop* io_loop : io_loops)
+            {
+                Acceptor* acceptor = new Acceptor(io_loop, ListenAddr_, true);
+                acceptor->SetNewConnectionCallback(std::bind(&TcpServer::EstablishConnection, this, io_loop,
+                                                   std::placeholders::_1, std::placeholders::_2));
+                if (AcceptBatch_ > 0)
+                {
+                    acceptor->SetAcceptBatch(AcceptBatch_);
+                }
+                LoopAcceptors_.push_back(acceptor);
+            }
+            // 所有Acceptor都创建好之后再开始listen, subloop中读取LoopAcceptors_时它已经不再变化
+            for (Acceptor* acceptor : LoopAcceptors_)
+            {
+                acceptor->GetLoop()->RunInLoop(std::bind(&Acceptor::Listen, acceptor));
+            }
+        }
+        else
+        {
+            loop_->RunInLoop(std::bind(&Acceptor::Listen, acceptor_.get()));
+        }
+    }
+}
+
+// 在subloop线程中执行
+void TcpServer::InitLoop(EventLoop* io_loop)
+{
+    if (LoopBusyPollUs_ > 0)
+    {
+        io_loop->SetBusyPoll(LoopBusyPollUs_);
+    }
+    if (threadinitcallback_)
+    {
+        threadinitcallback_(io_loop);
     }
-    
+}
+
+void TcpServer::SetAutoScale(int min_threads, int max_threads, int high_permille, int low_permille,
+                             double interval, int samples)
+{
+    if (ReusePort_)
+    {
+        LOG_ERROR("TcpServer [%s] auto scaling is not supported with SO_REUSEPORT\n", name_.c_str());
+        return;
+    }
+    ThreadPool_->SetAutoScale(min_threads, max_threads, high_permille, low_permille, interval, samples);
 }
 
 // 有一个新的客户端连接, accpetpr会执行这个回调
 void TcpServer::NewConnection(int sockfd, const InetAddress& peer_addr)
 {
-    // 轮询算法, 选择一个subloop来管理Channel
-    EventLoop* io_loop = ThreadPool_->GetNextLoop();
+    // 按分配策略选择一个subloop来管理Channel, 先攒起来, 这一批accept结束后再统一分发
+    // TcpConnection在subloop中创建, 从subloop的内存池分配, 这里只计数和记下socket
+    EventLoop* io_loop = ThreadPool_->GetLoopForPeer(peer_addr);
+    CountConnection(io_loop);
+    PendingConnections_[io_loop].push_back(AcceptedSocket{sockfd, peer_addr});
+}
+
+void TcpServer::DispatchNewConnections()
+{
+    // 每个subloop只投递一个回调, 只唤醒一次
+    for (auto& item : PendingConnections_)
+    {
+        if (!item.second.empty())
+        {
+            AcceptedList sockets;
+            sockets.swap(item.second);
+            item.first->RunInLoop(std::bind(&TcpServer::EstablishConnections, this, item.first, std::move(sockets)));
+        }
+    }
+}
+
+void TcpServer::EstablishConnections(EventLoop* io_loop, const AcceptedList& sockets)
+{
+    for (const AcceptedSocket& accepted : sockets)
+    {
+        CreateConnection(io_loop, accepted.sockfd, accepted.PeerAddr)->ConnectEstablished();
+    }
+}
+
+void TcpServer::EstablishConnection(EventLoop* io_loop, int sockfd, const InetAddress& peer_addr)
+{
+    CountConnection(io_loop);
+    CreateConnection(io_loop, sockfd, peer_addr)->ConnectEstablished();
+}
+
+void TcpServer::CountConnection(EventLoop* io_loop)
+{
+    // 分配时立即计数, 同一批accept中后面的连接就能看到前面的分配结果
+    io_loop->ConnectionAdded();
+    size_t num = ++NumConnections_;
+    if (MaxConnections_ > 0 && num >= static_cast<size_t>(MaxConnections_) && !AcceptPaused_.exchange(true))
+    {
+        LOG_INFO("TcpServer [%s] reached max connections %d, stop accepting\n", name_.c_str(), MaxConnections_);
+        SyncAccepting();
+    }
+}
+
+TcpConnectionPtr TcpServer::CreateConnection(EventLoop* io_loop, int sockfd, const InetAddress& peer_addr)
+{
     char buf[64] = {0};
-    snprintf(buf, sizeof(buf), "-%s#%d", ipPort_.c_str(), NextConnId_);
+    snprintf(buf, sizeof(buf), "-%s#%d", ipPort_.c_str(), NextConnId_++);
     std::string conn_name = name_ + buf;
 
     LOG_INFO("TcpServer::NewConnection [%s] - new connection [%s] from %s\n", 
@@ -86,23 +231,41 @@ void TcpServer::NewConnection(int sockfd, const InetAddress& peer_addr)
     }
     InetAddress local_addr(local);
 
-    // 根据连接成功的sockfd, 创建TcpConnection连接对象
-    TcpConnectionPtr conn(new TcpConnection(io_loop, conn_name, sockfd, local_addr, peer_addr));
-    connections_[conn_name] = conn;
+    // 根据连接成功的sockfd, 创建TcpConnection连接对象, 对象和引用计数一起从io_loop(当前loop)的内存池分配
+    TcpConnectionPtr conn = std::allocate_shared<TcpConnection>(SlabAllocator<TcpConnection>(),
+                                                                io_loop, conn_name, sockfd, local_addr, peer_addr);
+    {
+        std::lock_guard<std::mutex> lock(ConnectionsMutex_);
+        connections_[conn_name] = conn;
+    }
     // 下面的回调都是用户设置给TcpServer ==> TcpConnection ==> Channel ==> Poller ==> notify Channel调用回调
     conn->SetConnectionCallback(connectioncallback_);
     conn->SetMessageCallback(messagecallback_);
     conn->SetWriteCompleteCallback(writecompletecallback_);
+    conn->SetEdgeTriggered(EdgeTriggered_);
+    conn->SetEventByteBudget(EventByteBudget_);
+    conn->SetIdleTimeout(IdleTimeout_);
+    conn->SetBufferShrinkIdle(BufferShrinkIdle_);
+    conn->SetBufferBackend(BufferBackend_);
+    if (SocketBusyPollUs_ > 0)
+    {
+        conn->SetBusyPoll(SocketBusyPollUs_);
+    }
 
     // 设置了如何关闭连接的回调
     conn->SetCloseCallback(std::bind(&TcpServer::RemoveConnection, this, std::placeholders::_1));
 
-    // 直接调用TcpConnection::ConnectEstablished
-    io_loop->RunInLoop(std::bind(&TcpConnection::ConnectEstablished, conn));
+    return conn;
 }
 
 void TcpServer::RemoveConnection(const TcpConnectionPtr& conn)
 {
+    if (ReusePort_)
+    {
+        // SO_REUSEPORT模式下连接的整个生命周期都留在accept它的loop上
+        RemoveConnectionInLoop(conn);
+        return;
+    }
     loop_->RunInLoop(std::bind(&TcpServer::RemoveConnectionInLoop, this, conn));
 }
 
@@ -111,7 +274,70 @@ void TcpServer::RemoveConnectionInLoop(const TcpConnectionPtr& conn)
     LOG_INFO("TcpServer::RemoveConnectionInLoop [%s] - connection %s\n", 
             name_.c_str(), conn->Name().c_str());
     
-    size_t n = connections_.erase(conn->Name());
+    {
+        std::lock_guard<std::mutex> lock(ConnectionsMutex_);
+        connections_.erase(conn->Name());
+    }
+    conn->GetLoop()->ConnectionRemoved();
+    size_t num = --NumConnections_;
+    if (MaxConnections_ > 0 && num < static_cast<size_t>(MaxConnections_) && AcceptPaused_.exchange(false))
+    {
+        LOG_INFO("TcpServer [%s] connections below %d, resume accepting\n", name_.c_str(), MaxConnections_);
+        SyncAccepting();
+    }
     EventLoop* io_loop = conn->GetLoop();
     io_loop->QueneInLoop(std::bind(&TcpConnection::ConnectDestoryed, conn));
+}
+
+void TcpServer::DrainLoop(EventLoop* io_loop, bool force)
+{
+    ConnectionList conns;
+    {
+        std::lock_guard<std::mutex> lock(ConnectionsMutex_);
+        for (auto& item : connections_)
+        {
+            if (item.second->GetLoop() == io_loop)
+            {
+                conns.push_back(item.second);
+            }
+        }
+    }
+    // 关闭之后照常经过RemoveConnection移除, loop的连接数降到0
+    for (const TcpConnectionPtr& conn : conns)
+    {
+        if (force)
+        {
+            conn->ForceClose();
+        }
+        else
+        {
+            conn->Shutdown();
+        }
+    }
+}
+
+void TcpServer::SyncAccepting()
+{
+    // 暂停和恢复可能由不同的subloop先后发起, 投递到Acceptor所在loop的回调按最新的状态执行, 不会因为乱序停在错误的状态
+    if (LoopAcceptors_.empty())
+    {
+        loop_->RunInLoop(std::bind(&TcpServer::UpdateAccepting, this, acceptor_.get()));
+        return;
+    }
+    for (Acceptor* acceptor : LoopAcceptors_)
+    {
+        acceptor->GetLoop()->RunInLoop(std::bind(&TcpServer::UpdateAccepting, this, acceptor));
+    }
+}
+
+void TcpServer::UpdateAccepting(Acceptor* acceptor)
+{
+    if (AcceptPaused_.load())
+    {
+        acceptor->StopAccepting();
+    }
+    else
+    {
+        acceptor->StartAccepting();
+    }
 }
\ No newline at end of file
@@ -4,6 +4,8 @@
 #include <string>
 #include <memory>
 #include <atomic>
+#include <mutex>
+#include <vector>
 #include <unordered_map>
 
 #include "EventLoop.h"
@@ -21,6 +23,8 @@ class TcpServer: noncopyable
 public:
     using ThreadInitCallback = std::function<void(EventLoop*)>;
 
+    // kReusePort: 每个subloop各自持有一个SO_REUSEPORT监听socket, 连接在哪个loop上accept就由哪个loop处理
+    // 没有subloop时退化为BaseLoop上的单个监听socket
     enum Option
     {
         kNoReusePort,
@@ -32,32 +36,112 @@ public:
                 const std::string& name_arg, 
                 Option optin = kNoReusePort);
 
+    // 需要在BaseLoop线程中析构, 会等待各个subloop删除自己的Acceptor, 并执行完已经投递的连接批次
     ~TcpServer();
 
     // 设置底层subloop个数
     void SetThreadNum(int num_threads);
+    // 设置subloop的IO复用后端(epoll/io_uring), BaseLoop的后端由用户创建EventLoop时指定
+    void SetPollerBackend(Poller::Backend backend);
+
+    // subloop线程的CPU绑定和NUMA节点, 需要在Start之前调用, 见EventLoopThreadPool
+    void SetCpuAffinity(const std::vector<int>& cpus) { ThreadPool_->SetCpuAffinity(cpus); }
+    void SetNumaNodes(const std::vector<int>& nodes) { ThreadPool_->SetNumaNodes(nodes); }
+
+    // 新连接分配到subloop的策略, 默认轮询; SO_REUSEPORT模式下由内核分配, 不使用该策略
+    void SetPlacementPolicy(EventLoopThreadPool::PlacementPolicy policy) { ThreadPool_->SetPlacementPolicy(policy); }
+    void SetPlacementCallback(const EventLoopThreadPool::PlacementCallback& cb) { ThreadPool_->SetPlacementCallback(cb); }
+
+    // 根据subloop的忙碌占比自动增减subloop, 参数见EventLoopThreadPool::SetAutoScale, 需要在Start之前调用
+    // SO_REUSEPORT模式下每个subloop有自己的监听socket, 不支持自动扩缩容
+    void SetAutoScale(int min_threads, int max_threads, int high_permille = 750, int low_permille = 250,
+                      double interval = 1.0, int samples = 3);
+    void SetScaleCallback(const EventLoopThreadPool::ScaleCallback& cb) { ThreadPool_->SetScaleCallback(cb); }
+    // 退役的subloop上的连接超过seconds秒还没有关闭就先Shutdown, 再过seconds秒ForceClose
+    void SetRetireDrainTimeout(double seconds) { ThreadPool_->SetRetireDrainTimeout(seconds); }
+
+    // 在每个subloop中执行一次fn, 见EventLoopThreadPool::RunInAllLoops, 需要在Start之后调用
+    void RunInAllLoops(EventLoopThreadPool::Functor fn, EventLoopThreadPool::Functor done = EventLoopThreadPool::Functor())
+    {
+        ThreadPool_->RunInAllLoops(std::move(fn), std::move(done));
+    }
+    void RunInAllLoopsAndWait(EventLoopThreadPool::Functor fn) { ThreadPool_->RunInAllLoopsAndWait(std::move(fn)); }
 
+    // 自动扩容时新创建的subloop也会执行该回调
     void SetThreadInitCallback(const ThreadInitCallback& cb) { threadinitcallback_ = cb; }
     void SetConnectionCallback(const ConnectionCallback& cb) { connectioncallback_ = cb; }
     void SetMessageCallback(const MessageCallback& cb) { messagecallback_ = cb; }
     void SetWriteCompleteCallback(const WriteCompleteCallback& cb) { writecompletecallback_ = cb; }
 
+    // 新连接使用ET模式, 每次读写事件最多处理budget字节
+    void SetEdgeTriggered(bool on, size_t budget = 1024*1024) { EdgeTriggered_ = on; EventByteBudget_ = budget; }
+    // 连接seconds秒内没有收发数据就强制关闭, 由各个subloop的时间轮检测
+    void SetIdleTimeout(double seconds) { IdleTimeout_ = seconds; }
+    // 连接seconds秒内没有新数据就收缩大块的输入缓冲区, 见TcpConnection::SetBufferShrinkIdle
+    void SetBufferShrinkIdle(double seconds) { BufferShrinkIdle_ = seconds; }
+    // 新连接输入缓冲区的底层存储, 长期半满的流式连接可以使用kMirrorBackend, 见Buffer
+    void SetBufferBackend(Buffer::Backend backend) { BufferBackend_ = backend; }
+    // 处理连接的loop开启busy poll, 连接的socket可选设置SO_BUSY_POLL, 需要在Start之前调用
+    void SetBusyPoll(int64_t loop_spin_us, int socket_busy_poll_us = 0)
+    {
+        LoopBusyPollUs_ = loop_spin_us;
+        SocketBusyPollUs_ = socket_busy_poll_us;
+    }
+
+    // 连接数达到上限时暂停accept, 降到上限以下再恢复, 0表示不限制
+    // SO_REUSEPORT模式下各个subloop并发accept, 最多可能超出每个subloop一个连接
+    void SetMaxConnections(int max_connections) { MaxConnections_ = max_connections; }
+    // 当前的连接数
+    size_t NumConnections() const { return NumConnections_.load(); }
+
+    // 每次监听socket可读时最多accept多少个连接, 需要在Start之前调用
+    void SetAcceptBatch(int batch);
+
     // 开启服务器监听
     void Start();
 
 private:
+    void InitLoop(EventLoop* io_loop); // subloop线程启动时设置busy poll, 再执行用户的回调
     void NewConnection(int sockfd, const InetAddress& peer_addr);
+    // 一批accept结束, 每个subloop的新连接合并成一个回调投递过去
+    void DispatchNewConnections();
+    // 在io_loop上建立连接, SO_REUSEPORT模式下由各个subloop的Acceptor直接调用
+    void EstablishConnection(EventLoop* io_loop, int sockfd, const InetAddress& peer_addr);
+
+    // BaseLoop accept到, 还没有交给subloop创建TcpConnection的socket
+    struct AcceptedSocket
+    {
+        int sockfd;
+        InetAddress PeerAddr;
+    };
+    using AcceptedList = std::vector<AcceptedSocket>;
+    // 在io_loop中创建并建立一批连接
+    void EstablishConnections(EventLoop* io_loop, const AcceptedList& sockets);
+    // 分配到io_loop时立即计数, 按连接数达到上限暂停accept
+    void CountConnection(EventLoop* io_loop);
+    // 在io_loop线程中创建TcpConnection并设置好回调, 保存到connections_
+    // 连接对象, Channel, Socket都从io_loop的内存池分配, 之后也在io_loop中释放
+    TcpConnectionPtr CreateConnection(EventLoop* io_loop, int sockfd, const InetAddress& peer_addr);
     void RemoveConnection(const TcpConnectionPtr& conn);
     void RemoveConnectionInLoop(const TcpConnectionPtr& conn);
+    // 关闭退役的io_loop上剩余的连接, 由EventLoopThreadPool在BaseLoop中调用
+    void DrainLoop(EventLoop* io_loop, bool force);
+    // 在每个Acceptor所属的loop中按AcceptPaused_暂停/恢复accept
+    void SyncAccepting();
+    void UpdateAccepting(Acceptor* acceptor);
 
     using ConnectionMap = std::unordered_map<std::string, TcpConnectionPtr>;
+    using ConnectionList = std::vector<TcpConnectionPtr>;
 
     EventLoop* loop_; // BaseLoop 用户定义的loop
 
     const std::string ipPort_;
     const std::string name_;
+    const InetAddress ListenAddr_;
+    const bool ReusePort_;
 
     std::unique_ptr<Acceptor> acceptor_; // 运行在mainloop, 任务就是监听新连接事件
+    std::vector<Acceptor*> LoopAcceptors_; // SO_REUSEPORT模式下每个subloop的Acceptor, 在各自的loop中析构
 
     std::shared_ptr<EventLoopThreadPool> ThreadPool_; // one loop per thread
 
@@ -69,6 +153,19 @@ private:
 
     std::atomic_int started_;
 
-    int NextConnId_;
+    std::atomic_int NextConnId_;
+    bool EdgeTriggered_;
+    size_t EventByteBudget_;
+    double IdleTimeout_;
+    double BufferShrinkIdle_;
+    Buffer::Backend BufferBackend_;
+    int64_t LoopBusyPollUs_;
+    int SocketBusyPollUs_;
+    int AcceptBatch_;
+    int MaxConnections_;
+    std::atomic<size_t> NumConnections_;
+    std::atomic_bool AcceptPaused_;
+    std::unordered_map<EventLoop*, AcceptedList> PendingConnections_; // 本批accept到的连接, 只在BaseLoop中访问
+    std::mutex ConnectionsMutex_; // SO_REUSEPORT模式下多个subloop会同时增删连接
     ConnectionMap connections_; // 保存所有的连接
 };
\ No newline at end of file
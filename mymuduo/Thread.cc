@@ -1,12 +1,19 @@
 #include <semaphore.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <errno.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
 
 #include "Thread.h"
 #include "CurrentThread.h"
+#include "Logger.h"
 
 std::atomic_int Thread::NumCreated_(0);
 
 Thread::Thread(ThreadFunc func, const std::string& name)
-    : started_(false), joined_(false), tid_(0), func_(std::move(func)), name_(name)
+    : started_(false), joined_(false), tid_(0), func_(std::move(func)), name_(name), NumaNode_(-1)
 {
     SetDefaultName();
 }
@@ -30,6 +37,7 @@ void Thread::Start() // 一个Thread对象, 记录的就是一个新线程的详
     thread_ = std::shared_ptr<std::thread>(new std::thread([&](){
         // 获取线程的tid值
         tid_ = CurrentThread::Tid();
+        ApplyNameAndAffinity();
         sem_post(&sem);
         // 开启一个新线程, 专门执行该线程函数
         func_();
@@ -45,6 +53,93 @@ void Thread::Join()
     thread_->join();
 }
 
+void Thread::SetAffinity(const std::vector<int>& cpus, int numa_node)
+{
+    cpus_ = cpus;
+    NumaNode_ = numa_node;
+}
+
+// 解析/sys/devices/system/node/nodeN/cpulist, 格式如 0-3,8-11
+static std::vector<int> NumaNodeCpus(int node)
+{
+    std::vector<int> cpus;
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+    FILE* fp = fopen(path, "r");
+    if (fp == nullptr)
+    {
+        return cpus;
+    }
+    int first = 0;
+    while (fscanf(fp, "%d", &first) == 1)
+    {
+        int last = first;
+        int c = fgetc(fp);
+        if (c == '-')
+        {
+            if (fscanf(fp, "%d", &last) != 1)
+            {
+                break;
+            }
+            c = fgetc(fp);
+        }
+        for (int cpu = first; cpu <= last; cpu++)
+        {
+            cpus.push_back(cpu);
+        }
+        if (c != ',')
+        {
+            break;
+        }
+    }
+    fclose(fp);
+    return cpus;
+}
+
+void Thread::ApplyNameAndAffinity()
+{
+    // 内核限制线程名最长15个字符
+    pthread_setname_np(pthread_self(), name_.substr(0, 15).c_str());
+
+    std::vector<int> cpus = cpus_;
+    if (cpus.empty() && NumaNode_ >= 0)
+    {
+        cpus = NumaNodeCpus(NumaNode_);
+    }
+    if (!cpus.empty())
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : cpus)
+        {
+            if (cpu >= 0 && cpu < CPU_SETSIZE)
+            {
+                CPU_SET(cpu, &set);
+            }
+        }
+        int ret = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (ret != 0)
+        {
+            LOG_ERROR("thread %s set cpu affinity error: %d\n", name_.c_str(), ret);
+        }
+    }
+
+    // 之后本线程分配的内存优先落在NumaNode_上, 该节点内存不足时再退到其他节点
+    if (NumaNode_ >= 0)
+    {
+        unsigned long mask = 0;
+        const int max_node = static_cast<int>(sizeof(mask) * 8);
+        if (NumaNode_ < max_node)
+        {
+            mask = 1UL << NumaNode_;
+        }
+        if (mask == 0 || syscall(SYS_set_mempolicy, MPOL_PREFERRED, &mask, max_node + 1) < 0)
+        {
+            LOG_ERROR("thread %s set numa node %d error: %d\n", name_.c_str(), NumaNode_, errno);
+        }
+    }
+}
+
 void Thread::SetDefaultName()
 {
     int num = ++NumCreated_;
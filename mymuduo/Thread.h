@@ -6,6 +6,7 @@
 #include <unistd.h>
 #include <string>
 #include <atomic>
+#include <vector>
 
 #include "noncopyable.h"
 
@@ -17,6 +18,10 @@ public:
     explicit Thread(ThreadFunc, const std::string& name = std::string());
     ~Thread();
 
+    // 线程启动时绑定到cpus上, 并优先从numa_node分配内存, 需要在Start之前调用
+    // cpus为空时绑定到numa_node的所有CPU上, numa_node为-1时不设置内存策略
+    void SetAffinity(const std::vector<int>& cpus, int numa_node = -1);
+
     void Start();
     void Join();
 
@@ -29,6 +34,7 @@ public:
 
 private:
     void SetDefaultName();
+    void ApplyNameAndAffinity(); // 在新线程中调用
 
     bool started_;
     bool joined_;
@@ -36,5 +42,7 @@ private:
     pid_t tid_;
     ThreadFunc func_;
     std::string name_;
+    std::vector<int> cpus_;
+    int NumaNode_;
     static std::atomic_int NumCreated_;
 };
\ No newline at end of file
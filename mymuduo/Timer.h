@@ -0,0 +1,40 @@
+#pragma once
+
+#include <atomic>
+
+#include "noncopyable.h"
+#include "Timestamp.h"
+#include "Callbacks.h"
+
+// 定时器, 记录到期时间, 回调以及重复间隔
+class Timer: noncopyable
+{
+public:
+    Timer(TimerCallback cb, TimeStamp when, double interval)
+        : callback_(std::move(cb))
+        , expiration_(when)
+        , interval_(interval)
+        , repeat_(interval > 0.0)
+        , sequence_(++NumCreated_)
+    {}
+
+    void Run() const { callback_(); }
+
+    TimeStamp Expiration() const { return expiration_; }
+    bool Repeat() const { return repeat_; }
+    int64_t Sequence() const { return sequence_; }
+
+    // 重复定时器到期后, 以now为起点计算下一次到期时间
+    void Restart(TimeStamp now);
+
+    static int64_t NumCreated() { return NumCreated_; }
+
+private:
+    const TimerCallback callback_;
+    TimeStamp expiration_;
+    const double interval_; // 重复间隔, 单位秒
+    const bool repeat_;
+    const int64_t sequence_; // 全局唯一的序号, 和Timer*一起标识一个定时器
+
+    static std::atomic<int64_t> NumCreated_;
+};
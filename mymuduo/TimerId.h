@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdint.h>
+
+class Timer;
+
+/*
+定时器的句柄, 只包含Timer*和序号, 可以按值拷贝保存在连接对象中, 用来取消定时器
+序号用来区分地址被复用的Timer对象, 取消一个已经到期的定时器是安全的
+*/
+class TimerId
+{
+public:
+    TimerId(): timer_(nullptr), sequence_(0) {}
+    TimerId(Timer* timer, int64_t seq): timer_(timer), sequence_(seq) {}
+
+    friend class TimerQueue;
+
+private:
+    Timer* timer_;
+    int64_t sequence_;
+};
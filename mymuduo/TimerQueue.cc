@@ -0,0 +1,203 @@
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <algorithm>
+#include <iterator>
+
+#include "TimerQueue.h"
+#include "Timer.h"
+#include "EventLoop.h"
+#include "Logger.h"
+
+static int CreateTimerfd()
+{
+    int timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timerfd < 0)
+    {
+        LOG_FATAL("timerfd_create error: %d\n", errno);
+    }
+
+    return timerfd;
+}
+
+// 距离when还有多久, 最少100微秒, 避免timerfd被设置为0而关闭
+static timespec HowMuchTimeFromNow(TimeStamp when)
+{
+    int64_t microseconds = when.MicroSecondsSinceEpoch() - TimeStamp::now().MicroSecondsSinceEpoch();
+    if (microseconds < 100)
+    {
+        microseconds = 100;
+    }
+
+    timespec ts;
+    ts.tv_sec = static_cast<time_t>(microseconds / TimeStamp::kMicroSecondsPerSecond);
+    ts.tv_nsec = static_cast<long>((microseconds % TimeStamp::kMicroSecondsPerSecond) * 1000);
+    return ts;
+}
+
+static void ReadTimerfd(int timerfd)
+{
+    uint64_t howmany;
+    ssize_t n = read(timerfd, &howmany, sizeof(howmany));
+    if (n != sizeof(howmany))
+    {
+        LOG_ERROR("TimerQueue::HandleRead() reads %ld bytes instead of 8\n", n);
+    }
+}
+
+static void ResetTimerfd(int timerfd, TimeStamp expiration)
+{
+    itimerspec new_value;
+    itimerspec old_value;
+    memset(&new_value, 0, sizeof(new_value));
+    memset(&old_value, 0, sizeof(old_value));
+    new_value.it_value = HowMuchTimeFromNow(expiration);
+    if (timerfd_settime(timerfd, 0, &new_value, &old_value) < 0)
+    {
+        LOG_ERROR("timerfd_settime error: %d\n", errno);
+    }
+}
+
+TimerQueue::TimerQueue(EventLoop* loop)
+    : loop_(loop)
+    , timerfd_(CreateTimerfd())
+    , TimerfdChannel_(loop, timerfd_)
+    , CallingExpiredTimers_(false)
+{
+    TimerfdChannel_.SetReadCallback(std::bind(&TimerQueue::HandleRead, this));
+    TimerfdChannel_.EnableReading();
+}
+
+TimerQueue::~TimerQueue()
+{
+    TimerfdChannel_.DisableAll();
+    TimerfdChannel_.Remove();
+    close(timerfd_);
+
+    for (const Entry& timer : timers_)
+    {
+        delete timer.second;
+    }
+}
+
+TimerId TimerQueue::AddTimer(TimerCallback cb, TimeStamp when, double interval)
+{
+    Timer* timer = new Timer(std::move(cb), when, interval);
+    loop_->RunInLoop(std::bind(&TimerQueue::AddTimerInLoop, this, timer));
+    return TimerId(timer, timer->Sequence());
+}
+
+void TimerQueue::Cancel(TimerId timerid)
+{
+    loop_->RunInLoop(std::bind(&TimerQueue::CancelInLoop, this, timerid));
+}
+
+TimeStamp TimerQueue::EarliestExpiration() const
+{
+    if (timers_.empty())
+    {
+        return TimeStamp();
+    }
+    return timers_.begin()->first;
+}
+
+void TimerQueue::AddTimerInLoop(Timer* timer)
+{
+    bool earliest_changed = Insert(timer);
+    if (earliest_changed)
+    {
+        ResetTimerfd(timerfd_, timer->Expiration());
+    }
+}
+
+void TimerQueue::CancelInLoop(TimerId timerid)
+{
+    ActiveTimer timer(timerid.timer_, timerid.sequence_);
+    ActiveTimerSet::iterator it = ActiveTimers_.find(timer);
+    if (it != ActiveTimers_.end())
+    {
+        timers_.erase(Entry(it->first->Expiration(), it->first));
+        delete it->first;
+        ActiveTimers_.erase(it);
+    }
+    else if (CallingExpiredTimers_)
+    {
+        // 定时器正在执行自己的回调(比如重复定时器在回调中取消自己), 不能再重新插入
+        CancelingTimers_.insert(timer);
+    }
+}
+
+void TimerQueue::HandleRead()
+{
+    TimeStamp now(TimeStamp::now());
+    ReadTimerfd(timerfd_);
+
+    std::vector<Entry> expired = GetExpired(now);
+
+    CallingExpiredTimers_ = true;
+    CancelingTimers_.clear();
+    for (const Entry& it : expired)
+    {
+        it.second->Run();
+    }
+    CallingExpiredTimers_ = false;
+
+    Reset(expired, now);
+}
+
+std::vector<TimerQueue::Entry> TimerQueue::GetExpired(TimeStamp now)
+{
+    std::vector<Entry> expired;
+    // 第一个到期时间大于now的定时器, 之前的都已到期
+    Entry sentry(now, reinterpret_cast<Timer*>(UINTPTR_MAX));
+    TimerList::iterator end = timers_.lower_bound(sentry);
+    std::copy(timers_.begin(), end, back_inserter(expired));
+    timers_.erase(timers_.begin(), end);
+
+    for (const Entry& it : expired)
+    {
+        ActiveTimers_.erase(ActiveTimer(it.second, it.second->Sequence()));
+    }
+
+    return expired;
+}
+
+void TimerQueue::Reset(const std::vector<Entry>& expired, TimeStamp now)
+{
+    for (const Entry& it : expired)
+    {
+        ActiveTimer timer(it.second, it.second->Sequence());
+        if (it.second->Repeat() && CancelingTimers_.find(timer) == CancelingTimers_.end())
+        {
+            it.second->Restart(now);
+            Insert(it.second);
+        }
+        else
+        {
+            delete it.second;
+        }
+    }
+
+    if (!timers_.empty())
+    {
+        ResetTimerfd(timerfd_, timers_.begin()->second->Expiration());
+    }
+}
+
+bool TimerQueue::Insert(Timer* timer)
+{
+    bool earliest_changed = false;
+    TimeStamp when = timer->Expiration();
+    TimerList::iterator it = timers_.begin();
+    if (it == timers_.end() || when < it->first)
+    {
+        earliest_changed = true;
+    }
+
+    timers_.insert(Entry(when, timer));
+    ActiveTimers_.insert(ActiveTimer(timer, timer->Sequence()));
+
+    return earliest_changed;
+}
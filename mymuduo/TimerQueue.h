@@ -0,0 +1,60 @@
+#pragma once
+
+#include <set>
+#include <vector>
+#include <utility>
+
+#include "noncopyable.h"
+#include "Timestamp.h"
+#include "Callbacks.h"
+#include "Channel.h"
+#include "TimerId.h"
+
+class EventLoop;
+class Timer;
+
+/*
+每个EventLoop拥有一个TimerQueue, 所有定时器共用一个timerfd, timerfd通过Channel注册到Poller
+timerfd总是设置为最早到期的定时器的时间, 插入和取消都是有序集合上的O(log n)操作
+*/
+class TimerQueue: noncopyable
+{
+public:
+    explicit TimerQueue(EventLoop* loop);
+    ~TimerQueue();
+
+    // 可以跨线程调用, 真正的插入在loop线程中进行
+    TimerId AddTimer(TimerCallback cb, TimeStamp when, double interval);
+    void Cancel(TimerId timerid);
+
+    // 最早到期的定时器的时间, 没有定时器时返回无效时间, 只能在loop线程中调用
+    TimeStamp EarliestExpiration() const;
+
+private:
+    using Entry = std::pair<TimeStamp, Timer*>;
+    using TimerList = std::set<Entry>;
+    using ActiveTimer = std::pair<Timer*, int64_t>;
+    using ActiveTimerSet = std::set<ActiveTimer>;
+
+    void AddTimerInLoop(Timer* timer);
+    void CancelInLoop(TimerId timerid);
+    // timerfd可读, 执行所有到期的定时器
+    void HandleRead();
+
+    // 从timers_中移除所有到期的定时器
+    std::vector<Entry> GetExpired(TimeStamp now);
+    // 重复定时器重新插入, 其余的释放
+    void Reset(const std::vector<Entry>& expired, TimeStamp now);
+    // 返回插入的定时器是否成为了最早到期的定时器
+    bool Insert(Timer* timer);
+
+    EventLoop* loop_;
+    const int timerfd_;
+    Channel TimerfdChannel_;
+
+    TimerList timers_; // 按到期时间排序
+    ActiveTimerSet ActiveTimers_; // 按Timer*排序, 用于取消, 与timers_保存相同的定时器
+
+    bool CallingExpiredTimers_;
+    ActiveTimerSet CancelingTimers_; // 执行到期回调期间被取消的定时器
+};
@@ -1,4 +1,5 @@
 #include <time.h>
+#include <sys/time.h>
 
 #include "Timestamp.h"
 
@@ -10,13 +11,17 @@ TimeStamp::TimeStamp(int64_t MicroSecondsSinceEpoch)
 
 TimeStamp TimeStamp::now()
 {
-    return TimeStamp(time(NULL));
+    // 定时器需要微秒级精度, gettimeofday走vdso, 不会陷入内核
+    timeval tv;
+    gettimeofday(&tv, NULL);
+    return TimeStamp(static_cast<int64_t>(tv.tv_sec) * kMicroSecondsPerSecond + tv.tv_usec);
 }
 
 std::string TimeStamp::ToString() const
 {
     char buf[128] = {0};
-    tm* tm_time = localtime(&MicroSecondsSinceEpoch_);
+    time_t seconds = static_cast<time_t>(MicroSecondsSinceEpoch_ / kMicroSecondsPerSecond);
+    tm* tm_time = localtime(&seconds);
     snprintf(buf, 128, "%4d/%02d/%02d %02d:%02d:%02d", // 用'0'填充
     tm_time->tm_year + 1900, 
     tm_time->tm_mon + 1, 
@@ -26,4 +31,4 @@ std::string TimeStamp::ToString() const
     tm_time->tm_sec);
 
     return buf;
-}
\ No newline at end of file
+}
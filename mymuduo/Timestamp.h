@@ -15,6 +15,28 @@ public:
     static TimeStamp now();
     std::string ToString() const;
 
+    int64_t MicroSecondsSinceEpoch() const { return MicroSecondsSinceEpoch_; }
+    bool Valid() const { return MicroSecondsSinceEpoch_ > 0; }
+
+    static const int kMicroSecondsPerSecond = 1000 * 1000;
+
 private:
     int64_t MicroSecondsSinceEpoch_;
-};
\ No newline at end of file
+};
+
+inline bool operator<(TimeStamp lhs, TimeStamp rhs)
+{
+    return lhs.MicroSecondsSinceEpoch() < rhs.MicroSecondsSinceEpoch();
+}
+
+inline bool operator==(TimeStamp lhs, TimeStamp rhs)
+{
+    return lhs.MicroSecondsSinceEpoch() == rhs.MicroSecondsSinceEpoch();
+}
+
+// 返回timestamp之后seconds秒的时间点
+inline TimeStamp AddTime(TimeStamp timestamp, double seconds)
+{
+    int64_t delta = static_cast<int64_t>(seconds * TimeStamp::kMicroSecondsPerSecond);
+    return TimeStamp(timestamp.MicroSecondsSinceEpoch() + delta);
+}
@@ -0,0 +1,165 @@
+#include <math.h>
+
+#include "TimingWheel.h"
+#include "EventLoop.h"
+
+TimingWheel::TimingWheel(EventLoop* loop, double tick_seconds)
+    : loop_(loop)
+    , tick_(tick_seconds)
+    , now_(0)
+    , size_(0)
+{
+    for (int i = 0; i < kLevel0Slots; i++)
+    {
+        level0_[i].prev_ = level0_[i].next_ = &level0_[i];
+    }
+    for (int i = 0; i < kLevel1Slots; i++)
+    {
+        level1_[i].prev_ = level1_[i].next_ = &level1_[i];
+    }
+
+    TickTimer_ = loop_->RunEvery(tick_, std::bind(&TimingWheel::Advance, this));
+}
+
+TimingWheel::~TimingWheel()
+{
+    loop_->Cancel(TickTimer_);
+
+    // 条目由使用者持有, 这里只断开链接
+    Entry* heads[] = {level0_, level1_};
+    int counts[] = {kLevel0Slots, kLevel1Slots};
+    for (int level = 0; level < 2; level++)
+    {
+        for (int i = 0; i < counts[level]; i++)
+        {
+            Entry* head = &heads[level][i];
+            while (head->next_ != head)
+            {
+                Unlink(head->next_);
+            }
+        }
+    }
+}
+
+void TimingWheel::Add(Entry* entry, double timeout_seconds, ExpireCallback cb)
+{
+    if (entry->Linked())
+    {
+        Remove(entry);
+    }
+
+    // 当前tick已经过去了一部分, 多算一个tick, 保证实际空闲时间不少于timeout_seconds
+    uint64_t ticks = static_cast<uint64_t>(ceil(timeout_seconds / tick_));
+    entry->timeout_ = (ticks > 0 ? ticks : 1) + 1;
+    entry->deadline_ = now_ + entry->timeout_;
+    entry->callback_ = std::move(cb);
+    Insert(entry);
+    ++size_;
+}
+
+void TimingWheel::Remove(Entry* entry)
+{
+    if (entry->Linked())
+    {
+        Unlink(entry);
+        --size_;
+    }
+}
+
+void TimingWheel::Advance()
+{
+    ++now_;
+    if ((now_ & (kLevel0Slots - 1)) == 0)
+    {
+        Cascade();
+    }
+
+    // 先把当前槽整体摘下来, 回调中Add/Remove其他条目不会影响遍历
+    Entry* head = &level0_[now_ & (kLevel0Slots - 1)];
+    Entry expired;
+    if (head->next_ == head)
+    {
+        return;
+    }
+    expired.next_ = head->next_;
+    expired.prev_ = head->prev_;
+    expired.next_->prev_ = &expired;
+    expired.prev_->next_ = &expired;
+    head->prev_ = head->next_ = head;
+
+    while (expired.next_ != &expired)
+    {
+        Entry* entry = expired.next_;
+        Unlink(entry);
+        if (entry->deadline_ > now_)
+        {
+            Insert(entry); // 期间被Touch过, 按新的到期时间重新放入
+        }
+        else
+        {
+            --size_;
+            entry->callback_();
+        }
+    }
+}
+
+void TimingWheel::Insert(Entry* entry)
+{
+    if (entry->deadline_ < now_)
+    {
+        entry->deadline_ = now_;
+    }
+
+    uint64_t delta = entry->deadline_ - now_;
+    if (delta < static_cast<uint64_t>(kLevel0Slots))
+    {
+        Link(&level0_[entry->deadline_ & (kLevel0Slots - 1)], entry);
+    }
+    else
+    {
+        uint64_t slot = entry->deadline_ >> kLevel0Bits;
+        uint64_t limit = (now_ >> kLevel0Bits) + kLevel1Slots - 1;
+        if (slot > limit)
+        {
+            slot = limit; // 超出第1级范围, 到时再重新放入
+        }
+        Link(&level1_[slot & (kLevel1Slots - 1)], entry);
+    }
+}
+
+void TimingWheel::Cascade()
+{
+    Entry* head = &level1_[(now_ >> kLevel0Bits) & (kLevel1Slots - 1)];
+    Entry pending;
+    if (head->next_ == head)
+    {
+        return;
+    }
+    pending.next_ = head->next_;
+    pending.prev_ = head->prev_;
+    pending.next_->prev_ = &pending;
+    pending.prev_->next_ = &pending;
+    head->prev_ = head->next_ = head;
+
+    while (pending.next_ != &pending)
+    {
+        Entry* entry = pending.next_;
+        Unlink(entry);
+        Insert(entry);
+    }
+}
+
+void TimingWheel::Link(Entry* head, Entry* entry)
+{
+    entry->prev_ = head->prev_;
+    entry->next_ = head;
+    head->prev_->next_ = entry;
+    head->prev_ = entry;
+}
+
+void TimingWheel::Unlink(Entry* entry)
+{
+    entry->prev_->next_ = entry->next_;
+    entry->next_->prev_ = entry->prev_;
+    entry->prev_ = entry->next_ = nullptr;
+}
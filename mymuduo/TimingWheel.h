@@ -0,0 +1,75 @@
+#pragma once
+
+#include <functional>
+#include <stdint.h>
+
+#include "noncopyable.h"
+#include "TimerId.h"
+
+class EventLoop;
+
+/*
+两级分层时间轮, 用于大量连接的空闲超时检测, 整个时间轮只占用EventLoop的一个重复定时器
+第0级256个槽, 每槽一个tick; 第1级64个槽, 每槽256个tick, 超出范围的条目放在第1级最远的槽里
+Touch只更新条目的到期tick, 不移动链表节点, 是O(1)的; 槽到期时再检查条目是否真的过期,
+没有过期的条目按新的到期时间重新放入时间轮(惰性重排)
+*/
+class TimingWheel: noncopyable
+{
+public:
+    using ExpireCallback = std::function<void()>;
+
+    // 侵入式链表节点, 由使用者持有(比如TcpConnection), 节点销毁前必须先Remove
+    class Entry: noncopyable
+    {
+    public:
+        Entry(): prev_(nullptr), next_(nullptr), deadline_(0), timeout_(0) {}
+
+        bool Linked() const { return next_ != nullptr; }
+
+    private:
+        friend class TimingWheel;
+
+        Entry* prev_;
+        Entry* next_;
+        uint64_t deadline_; // 到期的tick
+        uint64_t timeout_; // 超时时长, 单位tick
+        ExpireCallback callback_;
+    };
+
+    // tick_seconds: 时间轮转动一格的时间
+    TimingWheel(EventLoop* loop, double tick_seconds);
+    ~TimingWheel();
+
+    // 加入时间轮, timeout_seconds秒内没有Touch就执行cb, 只能在loop线程中调用
+    void Add(Entry* entry, double timeout_seconds, ExpireCallback cb);
+    // 条目有活动, 到期时间顺延一个超时时长
+    void Touch(Entry* entry) { entry->deadline_ = now_ + entry->timeout_; }
+    void Remove(Entry* entry);
+
+    // 时间轮转动一格, 执行所有到期条目的回调
+    void Advance();
+
+    size_t Size() const { return size_; }
+
+private:
+    static const int kLevel0Bits = 8;
+    static const int kLevel0Slots = 1 << kLevel0Bits;
+    static const int kLevel1Slots = 64;
+
+    void Insert(Entry* entry);
+    // 把第1级当前槽的条目重新分配到第0级
+    void Cascade();
+    static void Link(Entry* head, Entry* entry);
+    static void Unlink(Entry* entry);
+
+    EventLoop* loop_;
+    const double tick_;
+    uint64_t now_; // 当前的tick
+    size_t size_;
+    TimerId TickTimer_;
+
+    // 每个槽是一个带哨兵的循环双向链表
+    Entry level0_[kLevel0Slots];
+    Entry level1_[kLevel1Slots];
+};